@@ -32,10 +32,79 @@ SaturatorEditor::SaturatorEditor(SaturatorProcessor& p)
     modeLabel.setJustificationType(juce::Justification::centred);
     addAndMakeVisible(modeLabel);
 
-    setSize(600, 350);
+    qualityBox.addItemList({"Standard", "Live 2x", "Live 1x", "2x", "4x", "8x", "16x"}, 1);
+    addAndMakeVisible(qualityBox);
+    qualityAttachment = std::make_unique<ComboBoxAttachment>(apvts, "quality", qualityBox);
+    qualityLabel.setText("Quality", juce::dontSendNotification);
+    qualityLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(qualityLabel);
+
+    filterBox.addItemList({"Polyphase IIR", "Linear Phase FIR"}, 1);
+    addAndMakeVisible(filterBox);
+    filterAttachment = std::make_unique<ComboBoxAttachment>(apvts, "filter", filterBox);
+    filterLabel.setText("Filter", juce::dontSendNotification);
+    filterLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(filterLabel);
+
+    offlineQualityBox.addItemList({"Same as Realtime", "Standard", "Live 2x", "Live 1x", "2x", "4x", "8x", "16x"}, 1);
+    addAndMakeVisible(offlineQualityBox);
+    offlineQualityAttachment = std::make_unique<ComboBoxAttachment>(apvts, "offlineQuality", offlineQualityBox);
+    offlineQualityLabel.setText("Offline", juce::dontSendNotification);
+    offlineQualityLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(offlineQualityLabel);
+
+    offlineFilterBox.addItemList({"Same as Realtime", "Polyphase IIR", "Linear Phase FIR"}, 1);
+    addAndMakeVisible(offlineFilterBox);
+    offlineFilterAttachment = std::make_unique<ComboBoxAttachment>(apvts, "offlineFilter", offlineFilterBox);
+    offlineFilterLabel.setText("Filter", juce::dontSendNotification);
+    offlineFilterLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(offlineFilterLabel);
+
+    bandsBox.addItemList({"Off", "2 Bands", "3 Bands"}, 1);
+    addAndMakeVisible(bandsBox);
+    bandsAttachment = std::make_unique<ComboBoxAttachment>(apvts, "bands", bandsBox);
+    bandsLabel.setText("Bands", juce::dontSendNotification);
+    bandsLabel.setJustificationType(juce::Justification::centred);
+    addAndMakeVisible(bandsLabel);
+
+    const std::array<std::pair<const char*, const char*>, numBandKnobs> bandKnobs {{
+        { "lowCrossover", "Low X" }, { "highCrossover", "High X" },
+        { "lowDrive", "Lo Drv" },    { "lowBias", "Lo Bias" },    { "lowSag", "Lo Sag" },
+        { "midDrive", "Mid Drv" },   { "midBias", "Mid Bias" },   { "midSag", "Mid Sag" },
+        { "highDrive", "Hi Drv" },   { "highBias", "Hi Bias" },   { "highSag", "Hi Sag" }
+    }};
+
+    for (size_t i = 0; i < bandKnobs.size(); ++i)
+    {
+        setupSlider(bandSliders[i], bandLabels[i], bandKnobs[i].first, bandKnobs[i].second, bandAttachments[i]);
+        bandSliders[i].setTextBoxStyle(juce::Slider::TextBoxBelow, false, 50, 18);
+    }
+
+    setSize(700, 560);
+    startTimerHz(meterRateHz);
+}
+
+SaturatorEditor::~SaturatorEditor()
+{
+    stopTimer();
 }
 
-SaturatorEditor::~SaturatorEditor() {}
+void SaturatorEditor::timerCallback()
+{
+    auto& meters = processor.getMeters();
+
+    auto toDb = [](float gain) { return juce::Decibels::gainToDecibels(gain, meterFloorDb); };
+
+    // Peaks jump up at once and fall back slowly; RMS is already averaged
+    const float peakFall = peakFallDbPerSecond / static_cast<float>(meterRateHz);
+    inputPeakDb = juce::jmax(toDb(SaturatorDSPBase::Meters::takePeak(meters.inputPeak)), inputPeakDb - peakFall);
+    outputPeakDb = juce::jmax(toDb(SaturatorDSPBase::Meters::takePeak(meters.outputPeak)), outputPeakDb - peakFall);
+    inputRmsDb = toDb(meters.inputRms.load(std::memory_order_relaxed));
+    outputRmsDb = toDb(meters.outputRms.load(std::memory_order_relaxed));
+    sagReductionDb = meters.sagReductionDb.load(std::memory_order_relaxed);
+
+    repaint(meterArea);
+}
 
 void SaturatorEditor::paint(juce::Graphics& g)
 {
@@ -45,6 +114,52 @@ void SaturatorEditor::paint(juce::Graphics& g)
     g.setFont(juce::Font(24.0f));
     g.drawText("SATURATOR", getLocalBounds().removeFromTop(40),
                juce::Justification::centred);
+
+    auto meters = meterArea;
+    const int meterWidth = meters.getWidth() / 3;
+    drawLevelMeter(g, meters.removeFromLeft(meterWidth), "IN", inputPeakDb, inputRmsDb);
+    drawLevelMeter(g, meters.removeFromLeft(meterWidth), "OUT", outputPeakDb, outputRmsDb);
+    drawReductionMeter(g, meters);
+}
+
+// RMS as a filled bar, peak as a line above it
+void SaturatorEditor::drawLevelMeter(juce::Graphics& g, juce::Rectangle<int> area, const juce::String& name,
+                                     float peakDb, float rmsDb) const
+{
+    g.setColour(juce::Colours::white.withAlpha(0.7f));
+    g.setFont(juce::Font(12.0f));
+    g.drawText(name, area.removeFromBottom(16), juce::Justification::centred);
+
+    const auto bar = area.reduced(4, 0).toFloat();
+    g.setColour(juce::Colour(0xff0f0f1e));
+    g.fillRect(bar);
+
+    auto heightFor = [&bar](float db)
+    {
+        return bar.getHeight() * juce::jlimit(0.0f, 1.0f, juce::jmap(db, meterFloorDb, 0.0f, 0.0f, 1.0f));
+    };
+
+    g.setColour(rmsDb > -6.0f ? juce::Colour(0xffe94560) : juce::Colour(0xff53d8a4));
+    g.fillRect(bar.withTop(bar.getBottom() - heightFor(rmsDb)));
+
+    g.setColour(juce::Colours::white);
+    g.fillRect(bar.withTop(bar.getBottom() - heightFor(peakDb)).withHeight(2.0f));
+}
+
+// Sag gain reduction, drawn down from the top
+void SaturatorEditor::drawReductionMeter(juce::Graphics& g, juce::Rectangle<int> area) const
+{
+    g.setColour(juce::Colours::white.withAlpha(0.7f));
+    g.setFont(juce::Font(12.0f));
+    g.drawText("SAG", area.removeFromBottom(16), juce::Justification::centred);
+
+    const auto bar = area.reduced(4, 0).toFloat();
+    g.setColour(juce::Colour(0xff0f0f1e));
+    g.fillRect(bar);
+
+    const float proportion = juce::jlimit(0.0f, 1.0f, sagReductionDb / sagRangeDb);
+    g.setColour(juce::Colour(0xfff5a623));
+    g.fillRect(bar.withHeight(bar.getHeight() * proportion));
 }
 
 void SaturatorEditor::resized()
@@ -52,6 +167,9 @@ void SaturatorEditor::resized()
     auto bounds = getLocalBounds().reduced(10);
     bounds.removeFromTop(40);
 
+    meterArea = bounds.removeFromRight(90).withTrimmedBottom(10);
+    bounds.removeFromRight(10);
+
     auto knobArea = bounds.removeFromTop(240);
     int knobWidth = knobArea.getWidth() / 6;
 
@@ -69,7 +187,37 @@ void SaturatorEditor::resized()
     setupKnob(knobArea.removeFromLeft(knobWidth), outputTrimSlider, outputTrimLabel);
     setupKnob(knobArea, mixSlider, mixLabel);
 
-    auto modeArea = bounds;
+    // Realtime row: mode, quality, filter. Offline row: quality, filter.
+    auto realtimeRow = bounds.removeFromTop(50);
+    auto offlineRow = bounds.removeFromTop(50);
+    const int columnWidth = realtimeRow.getWidth() / 3;
+
+    auto modeArea = realtimeRow.removeFromLeft(columnWidth);
     modeLabel.setBounds(modeArea.removeFromLeft(50));
     modeBox.setBounds(modeArea.reduced(5));
+
+    auto qualityArea = realtimeRow.removeFromLeft(columnWidth);
+    qualityLabel.setBounds(qualityArea.removeFromLeft(60));
+    qualityBox.setBounds(qualityArea.reduced(5));
+
+    auto filterArea = realtimeRow;
+    filterLabel.setBounds(filterArea.removeFromLeft(50));
+    filterBox.setBounds(filterArea.reduced(5));
+
+    auto offlineQualityArea = offlineRow.removeFromLeft(offlineRow.getWidth() / 2);
+    offlineQualityLabel.setBounds(offlineQualityArea.removeFromLeft(60));
+    offlineQualityBox.setBounds(offlineQualityArea.reduced(5));
+
+    auto offlineFilterArea = offlineRow;
+    offlineFilterLabel.setBounds(offlineFilterArea.removeFromLeft(50));
+    offlineFilterBox.setBounds(offlineFilterArea.reduced(5));
+
+    // Band row: band count above the crossover and per-band knobs
+    auto bandsArea = bounds.removeFromTop(30).removeFromLeft(columnWidth);
+    bandsLabel.setBounds(bandsArea.removeFromLeft(50));
+    bandsBox.setBounds(bandsArea.reduced(5, 2));
+
+    const int bandKnobWidth = bounds.getWidth() / numBandKnobs;
+    for (size_t i = 0; i < bandSliders.size(); ++i)
+        setupKnob(bounds.removeFromLeft(bandKnobWidth), bandSliders[i], bandLabels[i]);
 }
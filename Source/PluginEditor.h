@@ -2,7 +2,8 @@
 
 #include "PluginProcessor.h"
 
-class SaturatorEditor : public juce::AudioProcessorEditor
+class SaturatorEditor : public juce::AudioProcessorEditor,
+                        private juce::Timer
 {
 public:
     explicit SaturatorEditor(SaturatorProcessor&);
@@ -14,6 +15,24 @@ public:
 private:
     SaturatorProcessor& processor;
 
+    // --- Meters ---
+    // Polled from the processor's lock-free meters at meterRateHz. Levels
+    // are held in dB; peaks fall back at peakFallDbPerSecond.
+    static constexpr int meterRateHz = 30;
+    static constexpr float meterFloorDb = -60.0f;
+    static constexpr float peakFallDbPerSecond = 20.0f;
+    static constexpr float sagRangeDb = 24.0f;
+
+    float inputPeakDb = meterFloorDb, inputRmsDb = meterFloorDb;
+    float outputPeakDb = meterFloorDb, outputRmsDb = meterFloorDb;
+    float sagReductionDb = 0.0f;
+    juce::Rectangle<int> meterArea;
+
+    void timerCallback() override;
+    void drawLevelMeter(juce::Graphics& g, juce::Rectangle<int> area, const juce::String& name,
+                        float peakDb, float rmsDb) const;
+    void drawReductionMeter(juce::Graphics& g, juce::Rectangle<int> area) const;
+
     juce::Slider inputTrimSlider, driveSlider, biasSlider,
                  sagSlider, outputTrimSlider, mixSlider;
 
@@ -23,6 +42,27 @@ private:
     juce::ComboBox modeBox;
     juce::Label modeLabel;
 
+    juce::ComboBox qualityBox;
+    juce::Label qualityLabel;
+
+    juce::ComboBox filterBox;
+    juce::Label filterLabel;
+
+    juce::ComboBox offlineQualityBox;
+    juce::Label offlineQualityLabel;
+
+    juce::ComboBox offlineFilterBox;
+    juce::Label offlineFilterLabel;
+
+    // --- Multiband ---
+    // Crossovers, then drive, bias and sag for the low, mid and high bands
+    static constexpr int numBandKnobs = 2 + 3 * SaturatorDSPBase::maxBands;
+
+    juce::ComboBox bandsBox;
+    juce::Label bandsLabel;
+    std::array<juce::Slider, numBandKnobs> bandSliders;
+    std::array<juce::Label, numBandKnobs> bandLabels;
+
     using SliderAttachment = juce::AudioProcessorValueTreeState::SliderAttachment;
     using ComboBoxAttachment = juce::AudioProcessorValueTreeState::ComboBoxAttachment;
 
@@ -33,6 +73,12 @@ private:
     std::unique_ptr<SliderAttachment> outputTrimAttachment;
     std::unique_ptr<SliderAttachment> mixAttachment;
     std::unique_ptr<ComboBoxAttachment> modeAttachment;
+    std::unique_ptr<ComboBoxAttachment> qualityAttachment;
+    std::unique_ptr<ComboBoxAttachment> filterAttachment;
+    std::unique_ptr<ComboBoxAttachment> offlineQualityAttachment;
+    std::unique_ptr<ComboBoxAttachment> offlineFilterAttachment;
+    std::unique_ptr<ComboBoxAttachment> bandsAttachment;
+    std::array<std::unique_ptr<SliderAttachment>, numBandKnobs> bandAttachments;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SaturatorEditor)
 };
@@ -1,15 +1,111 @@
 #include "PluginProcessor.h"
 #include "PluginEditor.h"
 
+namespace
+{
+    // Parameter ID prefixes of the low, mid and high band controls
+    const char* const bandIds[] = { "low", "mid", "high" };
+    const char* const bandNames[] = { "Low", "Mid", "High" };
+}
+
 SaturatorProcessor::SaturatorProcessor()
     : AudioProcessor(BusesProperties()
                          .withInput("Input", juce::AudioChannelSet::stereo(), true)
                          .withOutput("Output", juce::AudioChannelSet::stereo(), true)),
       apvts(*this, nullptr, "Parameters", createParameterLayout())
 {
+    dspFloat.setMeters(&meters);
+    dspDouble.setMeters(&meters);
+
+    // Looked up once, so the audio thread builds no IDs
+    snapshot.attach(apvts);
+
+   #if SATURATOR_PROFILE_STAGES
+    dspFloat.setStageTrace(&stageTrace);
+    dspDouble.setStageTrace(&stageTrace);
+    stageTrace.startCollecting();
+   #endif
+
+    startTimerHz(10);
+}
+
+SaturatorProcessor::~SaturatorProcessor()
+{
+    stopTimer();
+
+   #if SATURATOR_PROFILE_STAGES
+    // SATURATOR_TRACE_FILE names the file; otherwise a fresh one in the
+    // temp directory. Instances that find the file taken write a numbered
+    // sibling, so a multi-instance session keeps every trace.
+    stageTrace.stopCollecting();
+
+    const auto path = juce::SystemStats::getEnvironmentVariable("SATURATOR_TRACE_FILE", {});
+    const auto file = path.isNotEmpty()
+                        ? juce::File::getCurrentWorkingDirectory().getChildFile(path).getNonexistentSibling(false)
+                        : juce::File::getSpecialLocation(juce::File::tempDirectory)
+                              .getNonexistentChildFile("saturator-trace", ".json");
+
+    if (! stageTrace.getEvents().empty())
+        stageTrace.writeChromeTrace(file);
+   #endif
+}
+
+void SaturatorProcessor::ParameterSnapshot::Value::attach(juce::AudioProcessorValueTreeState& state,
+                                                          const juce::String& id)
+{
+    source = state.getRawParameterValue(id);
+    jassert(source != nullptr);
+}
+
+void SaturatorProcessor::ParameterSnapshot::Value::update(bool forceChanged)
+{
+    const float next = source->load(std::memory_order_relaxed);
+    changed = forceChanged || ! juce::exactlyEqual(next, value);
+    value = next;
 }
 
-SaturatorProcessor::~SaturatorProcessor() {}
+void SaturatorProcessor::ParameterSnapshot::attach(juce::AudioProcessorValueTreeState& state)
+{
+    inputTrim.attach(state, "inputTrim");
+    drive.attach(state, "drive");
+    bias.attach(state, "bias");
+    sag.attach(state, "sag");
+    outputTrim.attach(state, "outputTrim");
+    mix.attach(state, "mix");
+    mode.attach(state, "mode");
+
+    quality.attach(state, "quality");
+    filter.attach(state, "filter");
+    offlineQuality.attach(state, "offlineQuality");
+    offlineFilter.attach(state, "offlineFilter");
+
+    bands.attach(state, "bands");
+    lowCrossover.attach(state, "lowCrossover");
+    highCrossover.attach(state, "highCrossover");
+
+    for (size_t b = 0; b < bandControls.size(); ++b)
+    {
+        const juce::String id(bandIds[b]);
+        bandControls[b].drive.attach(state, id + "Drive");
+        bandControls[b].bias.attach(state, id + "Bias");
+        bandControls[b].sag.attach(state, id + "Sag");
+    }
+}
+
+void SaturatorProcessor::ParameterSnapshot::update(bool forceChanged)
+{
+    for (auto* v : { &inputTrim, &drive, &bias, &sag, &outputTrim, &mix, &mode,
+                     &quality, &filter, &offlineQuality, &offlineFilter,
+                     &bands, &lowCrossover, &highCrossover })
+        v->update(forceChanged);
+
+    for (auto& band : bandControls)
+    {
+        band.drive.update(forceChanged);
+        band.bias.update(forceChanged);
+        band.sag.update(forceChanged);
+    }
+}
 
 juce::AudioProcessorValueTreeState::ParameterLayout SaturatorProcessor::createParameterLayout()
 {
@@ -50,6 +146,65 @@ juce::AudioProcessorValueTreeState::ParameterLayout SaturatorProcessor::createPa
         juce::StringArray{"Triode", "Pentode", "Torture"},
         0));
 
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{"quality", 1}, "Quality",
+        juce::StringArray{"Standard", "Live 2x", "Live 1x", "2x", "4x", "8x", "16x"},
+        0));
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{"filter", 1}, "Filter",
+        juce::StringArray{"Polyphase IIR", "Linear Phase FIR"},
+        0));
+
+    // Used instead of the realtime pair while the host renders offline
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{"offlineQuality", 1}, "Offline Quality",
+        juce::StringArray{"Same as Realtime", "Standard", "Live 2x", "Live 1x", "2x", "4x", "8x", "16x"},
+        0));
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{"offlineFilter", 1}, "Offline Filter",
+        juce::StringArray{"Same as Realtime", "Polyphase IIR", "Linear Phase FIR"},
+        0));
+
+    params.push_back(std::make_unique<juce::AudioParameterChoice>(
+        juce::ParameterID{"bands", 1}, "Bands",
+        juce::StringArray{"Off", "2 Bands", "3 Bands"},
+        0));
+
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID{"lowCrossover", 1}, "Low Crossover",
+        juce::NormalisableRange<float>(40.0f, 1000.0f, 1.0f, 0.4f),
+        200.0f));
+
+    params.push_back(std::make_unique<juce::AudioParameterFloat>(
+        juce::ParameterID{"highCrossover", 1}, "High Crossover",
+        juce::NormalisableRange<float>(1000.0f, 10000.0f, 1.0f, 0.4f),
+        2500.0f));
+
+    // Per-band drive, bias and sag. A band at 0 dB drive is off. In the
+    // 2-band mode the high band's controls drive the upper band.
+    for (size_t b = 0; b < SaturatorDSPBase::maxBands; ++b)
+    {
+        const juce::String id(bandIds[b]);
+        const juce::String name(bandNames[b]);
+
+        params.push_back(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID{id + "Drive", 1}, name + " Drive",
+            juce::NormalisableRange<float>(0.0f, 60.0f, 0.1f, 0.4f),
+            12.0f));
+
+        params.push_back(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID{id + "Bias", 1}, name + " Bias",
+            juce::NormalisableRange<float>(-0.6f, 0.6f, 0.01f),
+            0.0f));
+
+        params.push_back(std::make_unique<juce::AudioParameterFloat>(
+            juce::ParameterID{id + "Sag", 1}, name + " Sag",
+            juce::NormalisableRange<float>(0.0f, 0.6f, 0.01f),
+            0.15f));
+    }
+
     return { params.begin(), params.end() };
 }
 
@@ -57,16 +212,94 @@ const juce::String SaturatorProcessor::getName() const { return JucePlugin_Name;
 bool SaturatorProcessor::acceptsMidi() const { return false; }
 bool SaturatorProcessor::producesMidi() const { return false; }
 bool SaturatorProcessor::isMidiEffect() const { return false; }
-double SaturatorProcessor::getTailLengthSeconds() const { return 0.0; }
+double SaturatorProcessor::getTailLengthSeconds() const
+{
+    return isUsingDoublePrecision() ? dspDouble.getTailLengthSeconds() : dspFloat.getTailLengthSeconds();
+}
+
+bool SaturatorProcessor::supportsDoublePrecisionProcessing() const { return true; }
+
 int SaturatorProcessor::getNumPrograms() { return 1; }
 int SaturatorProcessor::getCurrentProgram() { return 0; }
 void SaturatorProcessor::setCurrentProgram(int) {}
 const juce::String SaturatorProcessor::getProgramName(int) { return {}; }
 void SaturatorProcessor::changeProgramName(int, const juce::String&) {}
 
+// The realtime quality and filter, or the offline pair where one is set.
+// Read from the snapshot, or straight from the parameters off the audio
+// thread.
+SaturatorDSPBase::QualitySetting SaturatorProcessor::getQualitySetting(bool offline, bool fromParameters) const
+{
+    auto read = [fromParameters](const ParameterSnapshot::Value& v)
+    {
+        return static_cast<int>(fromParameters ? v.source->load(std::memory_order_relaxed) : v.value);
+    };
+
+    const int qualityIndex = read(snapshot.quality);
+    const int filterIndex = read(snapshot.filter);
+
+    SaturatorDSPBase::QualitySetting setting { static_cast<SaturatorDSPBase::Quality>(qualityIndex),
+                                               static_cast<SaturatorDSPBase::Filter>(filterIndex) };
+
+    if (offline)
+    {
+        // Index 0 of each offline choice defers to the realtime value
+        const int offlineQualityIndex = read(snapshot.offlineQuality);
+        const int offlineFilterIndex = read(snapshot.offlineFilter);
+
+        if (offlineQualityIndex > 0)
+            setting.quality = static_cast<SaturatorDSPBase::Quality>(offlineQualityIndex - 1);
+
+        if (offlineFilterIndex > 0)
+            setting.filter = static_cast<SaturatorDSPBase::Filter>(offlineFilterIndex - 1);
+    }
+
+    return setting;
+}
+
+// 1 for the full-band chain, else 2 or 3
+int SaturatorProcessor::getNumBands(bool fromParameters) const
+{
+    const float index = fromParameters ? snapshot.bands.source->load(std::memory_order_relaxed) : snapshot.bands.value;
+    return static_cast<int>(index) + 1;
+}
+
 void SaturatorProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
 {
-    dsp.prepare(sampleRate, samplesPerBlock, getTotalNumInputChannels());
+    float latency = 0.0f;
+
+    // The settings are read fresh here; the next block treats every
+    // parameter as changed
+    snapshot.update(true);
+    snapshotStale = true;
+
+    // Only the realtime and offline settings, at the chosen band count, get
+    // oversamplers. Any other choice runs as them until timerCallback()
+    // prepares again.
+    lastQuality = getQualitySetting(isNonRealtime());
+    preparedRealtime = getQualitySetting(false);
+    preparedOffline = getQualitySetting(true);
+    preparedBands = getNumBands();
+    const int numBands = preparedBands;
+
+    // Offline renders may spread the bands over worker threads; realtime
+    // processing stays on the host's thread
+    const int numThreads = isNonRealtime() ? SaturatorDSPBase::maxBands : 1;
+
+    if (isUsingDoublePrecision())
+    {
+        dspDouble.setThreadCount(numThreads);
+        dspDouble.setQualitiesInUse({ preparedRealtime, preparedOffline }, numBands);
+        dspDouble.prepare(sampleRate, samplesPerBlock, getTotalNumInputChannels());
+        latency = dspDouble.getLatencyInSamples(lastQuality);
+    }
+    else
+    {
+        dspFloat.setThreadCount(numThreads);
+        dspFloat.setQualitiesInUse({ preparedRealtime, preparedOffline }, numBands);
+        dspFloat.prepare(sampleRate, samplesPerBlock, getTotalNumInputChannels());
+        latency = dspFloat.getLatencyInSamples(lastQuality);
+    }
 
     double rampTimeSecs = 0.05;
     smoothInputTrim.reset(sampleRate, rampTimeSecs);
@@ -76,19 +309,32 @@ void SaturatorProcessor::prepareToPlay(double sampleRate, int samplesPerBlock)
     smoothOutputTrim.reset(sampleRate, rampTimeSecs);
     smoothMix.reset(sampleRate, rampTimeSecs);
 
-    setLatencySamples(static_cast<int>(
-        std::ceil(dsp.getLatencyInSamples(SaturatorDSP::Mode::Triode))));
+    for (auto& band : bandSmoothing)
+    {
+        band.drive.reset(sampleRate, rampTimeSecs);
+        band.bias.reset(sampleRate, rampTimeSecs);
+        band.sag.reset(sampleRate, rampTimeSecs);
+    }
+
+    setLatencySamples(static_cast<int>(std::ceil(latency)));
+    hostPrepared = true;
 }
 
 void SaturatorProcessor::releaseResources()
 {
-    dsp.reset();
+    hostPrepared = false;
+
+    if (isUsingDoublePrecision())
+        dspDouble.reset();
+    else
+        dspFloat.reset();
 }
 
 bool SaturatorProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 {
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-        && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // Any layout up to 7.1.4; channels are processed independently
+    const auto numChannels = layouts.getMainOutputChannelSet().size();
+    if (numChannels < 1 || numChannels > SaturatorDSPBase::maxChannels)
         return false;
 
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
@@ -98,6 +344,17 @@ bool SaturatorProcessor::isBusesLayoutSupported(const BusesLayout& layouts) cons
 }
 
 void SaturatorProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer&)
+{
+    processSamples(buffer, dspFloat);
+}
+
+void SaturatorProcessor::processBlock(juce::AudioBuffer<double>& buffer, juce::MidiBuffer&)
+{
+    processSamples(buffer, dspDouble);
+}
+
+template <typename SampleType>
+void SaturatorProcessor::processSamples(juce::AudioBuffer<SampleType>& buffer, SaturatorDSP<SampleType>& dspToUse)
 {
     juce::ScopedNoDenormals noDenormals;
 
@@ -107,45 +364,118 @@ void SaturatorProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::Mi
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear(i, 0, buffer.getNumSamples());
 
-    float inputTrimDb  = apvts.getRawParameterValue("inputTrim")->load();
-    float driveDb      = apvts.getRawParameterValue("drive")->load();
-    float bias         = apvts.getRawParameterValue("bias")->load();
-    float sag          = apvts.getRawParameterValue("sag")->load();
-    float outputTrimDb = apvts.getRawParameterValue("outputTrim")->load();
-    float mix          = apvts.getRawParameterValue("mix")->load() / 100.0f;
-    int modeIndex      = static_cast<int>(apvts.getRawParameterValue("mode")->load());
-    auto mode          = static_cast<SaturatorDSP::Mode>(modeIndex);
-
-    smoothInputTrim.setTargetValue(inputTrimDb);
-    smoothDrive.setTargetValue(driveDb);
-    smoothBias.setTargetValue(bias);
-    smoothSag.setTargetValue(sag);
-    smoothOutputTrim.setTargetValue(outputTrimDb);
-    smoothMix.setTargetValue(mix);
-
-    int numSamples = buffer.getNumSamples();
-    smoothInputTrim.skip(numSamples);
-    smoothDrive.skip(numSamples);
-    smoothBias.skip(numSamples);
-    smoothSag.skip(numSamples);
-    smoothOutputTrim.skip(numSamples);
-    smoothMix.skip(numSamples);
-
-    if (mode != lastMode)
+    snapshot.update(std::exchange(snapshotStale, false));
+
+    // The mode and quality are decoded again only when their controls, or
+    // the realtime/offline state, change
+    if (snapshot.mode.changed)
+        currentMode = static_cast<SaturatorDSPBase::Mode>(static_cast<int>(snapshot.mode.value));
+
+    const bool nonRealtime = isNonRealtime();
+    if (nonRealtime != currentNonRealtime || snapshot.quality.changed || snapshot.filter.changed
+        || snapshot.offlineQuality.changed || snapshot.offlineFilter.changed)
     {
-        lastMode = mode;
+        currentNonRealtime = nonRealtime;
+        currentQuality = getQualitySetting(nonRealtime);
+
+        // Nothing is built here. A setting outside the prepared pair runs
+        // as the prepared one until the message thread prepares again.
+        if (currentQuality != preparedRealtime && currentQuality != preparedOffline)
+            currentQuality = nonRealtime ? preparedOffline : preparedRealtime;
+    }
+
+    const auto mode = currentMode;
+    const auto quality = currentQuality;
+
+    // A host back in realtime without a new prepareToPlay runs serially
+    if (! nonRealtime)
+        dspToUse.setThreadCount(1);
+
+    // Smoothers only take a new target when their control moved
+    auto retarget = [](juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>& smoothed,
+                       const ParameterSnapshot::Value& v)
+    {
+        if (v.changed)
+            smoothed.setTargetValue(v.value);
+    };
+
+    retarget(smoothInputTrim, snapshot.inputTrim);
+    retarget(smoothDrive, snapshot.drive);
+    retarget(smoothBias, snapshot.bias);
+    retarget(smoothSag, snapshot.sag);
+    retarget(smoothOutputTrim, snapshot.outputTrim);
+
+    if (snapshot.mix.changed)
+        smoothMix.setTargetValue(snapshot.mix.value / 100.0f);
+
+    for (size_t b = 0; b < bandSmoothing.size(); ++b)
+    {
+        retarget(bandSmoothing[b].drive, snapshot.bandControls[b].drive);
+        retarget(bandSmoothing[b].bias, snapshot.bandControls[b].bias);
+        retarget(bandSmoothing[b].sag, snapshot.bandControls[b].sag);
+    }
+
+    // Mode changes keep the latency; only a quality or filter change, or a
+    // switch between realtime and offline settings, reports a new one
+    if (quality != lastQuality)
+    {
+        lastQuality = quality;
         setLatencySamples(static_cast<int>(
-            std::ceil(dsp.getLatencyInSamples(mode))));
+            std::ceil(dspToUse.getLatencyInSamples(quality))));
     }
 
-    dsp.process(buffer,
-                smoothInputTrim.getCurrentValue(),
-                smoothDrive.getCurrentValue(),
-                smoothBias.getCurrentValue(),
-                smoothSag.getCurrentValue(),
-                smoothOutputTrim.getCurrentValue(),
-                smoothMix.getCurrentValue(),
-                mode);
+    // Each parameter is handed over as a ramp across this block, so the DSP
+    // smooths per sample regardless of the host buffer size
+    const int numSamples = buffer.getNumSamples();
+    auto nextRamp = [numSamples](juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear>& smoothed)
+    {
+        const float start = smoothed.getCurrentValue();
+        return SaturatorDSPBase::Ramp(start, smoothed.skip(numSamples));
+    };
+
+    SaturatorDSPBase::Parameters params;
+    params.inputTrimDb  = nextRamp(smoothInputTrim);
+    params.driveDb      = nextRamp(smoothDrive);
+    params.bias         = nextRamp(smoothBias);
+    params.sagAmount    = nextRamp(smoothSag);
+    params.outputTrimDb = nextRamp(smoothOutputTrim);
+    params.mix          = nextRamp(smoothMix);
+
+    // A new Bands choice takes effect once the timer has prepared for it
+    params.numBands        = preparedBands;
+    params.lowCrossoverHz  = snapshot.lowCrossover.value;
+    params.highCrossoverHz = snapshot.highCrossover.value;
+
+    // Every band's smoothing advances, so a band joins the split at its
+    // current setting. With two bands the high controls take the upper band.
+    std::array<SaturatorDSPBase::BandParameters, SaturatorDSPBase::maxBands> bandRamps;
+    for (size_t b = 0; b < bandSmoothing.size(); ++b)
+        bandRamps[b] = { nextRamp(bandSmoothing[b].drive), nextRamp(bandSmoothing[b].bias),
+                         nextRamp(bandSmoothing[b].sag) };
+
+    params.bands = bandRamps;
+    if (params.numBands == 2)
+        params.bands[1] = bandRamps[2];
+
+    dspToUse.process(buffer, params, mode, quality);
+}
+
+// Runs on the message thread. A Quality, Filter or Bands choice outside
+// the prepared ones is built here, with processing suspended, rather than on
+// the audio thread. The chain restarts from cleared state, as after any
+// prepareToPlay.
+void SaturatorProcessor::timerCallback()
+{
+    if (! hostPrepared)
+        return;
+
+    if (getQualitySetting(false, true) == preparedRealtime && getQualitySetting(true, true) == preparedOffline
+        && getNumBands(true) == preparedBands)
+        return;
+
+    suspendProcessing(true);
+    prepareToPlay(getSampleRate(), getBlockSize());
+    suspendProcessing(false);
 }
 
 bool SaturatorProcessor::hasEditor() const { return true; }
@@ -4,7 +4,12 @@
 #include <juce_dsp/juce_dsp.h>
 #include "SaturatorDSP.h"
 
-class SaturatorProcessor : public juce::AudioProcessor
+#if SATURATOR_PROFILE_STAGES
+ #include "StageTrace.h"
+#endif
+
+class SaturatorProcessor : public juce::AudioProcessor,
+                           private juce::Timer
 {
 public:
     SaturatorProcessor();
@@ -16,6 +21,8 @@ public:
     bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
 
     void processBlock(juce::AudioBuffer<float>&, juce::MidiBuffer&) override;
+    void processBlock(juce::AudioBuffer<double>&, juce::MidiBuffer&) override;
+    bool supportsDoublePrecisionProcessing() const override;
 
     juce::AudioProcessorEditor* createEditor() override;
     bool hasEditor() const override;
@@ -37,12 +44,27 @@ public:
     void setStateInformation(const void* data, int sizeInBytes) override;
 
     juce::AudioProcessorValueTreeState& getAPVTS() { return apvts; }
+    SaturatorDSPBase::Meters& getMeters() { return meters; }
 
 private:
     juce::AudioProcessorValueTreeState apvts;
     juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
 
-    SaturatorDSP dsp;
+    // Only the instance matching the host's processing precision is
+    // prepared and run
+    SaturatorDSP<float> dspFloat;
+    SaturatorDSP<double> dspDouble;
+
+    // Published by whichever instance runs, read by the editor
+    SaturatorDSPBase::Meters meters;
+
+   #if SATURATOR_PROFILE_STAGES
+    // Stage timeline of the whole session, saved when the processor goes
+    StageTrace stageTrace { "Saturator" };
+   #endif
+
+    template <typename SampleType>
+    void processSamples(juce::AudioBuffer<SampleType>& buffer, SaturatorDSP<SampleType>& dspToUse);
 
     juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> smoothInputTrim;
     juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> smoothDrive;
@@ -51,7 +73,73 @@ private:
     juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> smoothOutputTrim;
     juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> smoothMix;
 
-    SaturatorDSP::Mode lastMode = SaturatorDSP::Mode::Triode;
+    // Low, mid and high band controls
+    struct BandSmoothing
+    {
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> drive;
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> bias;
+        juce::SmoothedValue<float, juce::ValueSmoothingTypes::Linear> sag;
+    };
+    std::array<BandSmoothing, SaturatorDSPBase::maxBands> bandSmoothing;
+
+    // --- Parameter snapshot ---
+    // Every parameter's raw value, read once at the top of a block. The
+    // atomics are looked up by ID in the constructor, so the audio thread
+    // builds no strings, and each value is flagged when it differs from
+    // the previous read. Quantities derived from the values are only
+    // worked out again when one of their inputs is flagged.
+    struct ParameterSnapshot
+    {
+        struct Value
+        {
+            std::atomic<float>* source = nullptr;
+            float value = 0.0f;
+            bool changed = true;
+
+            void attach(juce::AudioProcessorValueTreeState& state, const juce::String& id);
+            void update(bool forceChanged);
+        };
+
+        struct Band
+        {
+            Value drive, bias, sag;
+        };
+
+        Value inputTrim, drive, bias, sag, outputTrim, mix, mode;
+        Value quality, filter, offlineQuality, offlineFilter;
+        Value bands, lowCrossover, highCrossover;
+        std::array<Band, SaturatorDSPBase::maxBands> bandControls;
+
+        void attach(juce::AudioProcessorValueTreeState& state);
+
+        // Reads every value and sets its changed flag, or raises them all
+        void update(bool forceChanged);
+    };
+    ParameterSnapshot snapshot;
+
+    // Set by prepareToPlay, so the first block afterwards treats every
+    // parameter as changed
+    bool snapshotStale = true;
+
+    // Derived from the snapshot when their inputs change
+    SaturatorDSPBase::Mode currentMode = SaturatorDSPBase::Mode::Triode;
+    SaturatorDSPBase::QualitySetting currentQuality;
+    bool currentNonRealtime = false;
+
+    int getNumBands(bool fromParameters = false) const;
+
+    SaturatorDSPBase::QualitySetting getQualitySetting(bool offline, bool fromParameters = false) const;
+    SaturatorDSPBase::QualitySetting lastQuality;
+
+    // --- Prepared settings ---
+    // What the DSP was last prepared with. Written only while processing is
+    // stopped or suspended. The timer prepares again when the chosen
+    // settings leave them.
+    SaturatorDSPBase::QualitySetting preparedRealtime, preparedOffline;
+    int preparedBands = 1;
+    bool hostPrepared = false;
+
+    void timerCallback() override;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SaturatorProcessor)
 };
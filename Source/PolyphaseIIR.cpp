@@ -0,0 +1,98 @@
+#include "PolyphaseIIR.h"
+
+template <typename SampleType>
+PolyphaseIIR<SampleType>::PolyphaseIIR(int stages, int numChannels)
+    : design(getDesign()),
+      numStages(juce::jlimit(1, maxStages, stages)),
+      channels(static_cast<size_t>(numChannels))
+{
+    // JUCE delays the output to the next whole sample with a Thiran
+    // allpass, pushed past 0.618 samples where its response is flattest
+    const auto uncompensated = design.uncompensatedLatency[static_cast<size_t>(numStages - 1)];
+
+    fractionalDelay = SampleType(1) - (uncompensated - std::floor(uncompensated));
+
+    if (juce::approximatelyEqual(fractionalDelay, SampleType(1)))
+        fractionalDelay = 0;
+    else if (fractionalDelay < SampleType(0.618))
+        fractionalDelay += SampleType(1);
+
+    latency = uncompensated + fractionalDelay;
+    delayCoefficient = (SampleType(1) - fractionalDelay) / (SampleType(1) + fractionalDelay);
+}
+
+template <typename SampleType>
+void PolyphaseIIR<SampleType>::reset()
+{
+    std::fill(channels.begin(), channels.end(), State<SampleType> {});
+}
+
+template <typename SampleType>
+void PolyphaseIIR<SampleType>::snapToZero(State<SampleType>& state)
+{
+    for (size_t s = 0; s < static_cast<size_t>(maxStages); ++s)
+    {
+        for (auto& v : state.up[s])   juce::dsp::util::snapToZero(v);
+        for (auto& v : state.down[s]) juce::dsp::util::snapToZero(v);
+    }
+}
+
+// The allpass coefficients come from the same FilterDesign call with the
+// same transition widths and stopband attenuations juce::dsp::Oversampling
+// uses at maximum quality. Its latency is read from a polyphase IIR
+// oversampler of each stage count, without integer latency.
+template <typename SampleType>
+const typename PolyphaseIIR<SampleType>::Design& PolyphaseIIR<SampleType>::getDesign()
+{
+    static const Design shared = []
+    {
+        Design d;
+
+        for (int n = 0; n < maxStages; ++n)
+        {
+            const auto twUp = 0.10f * (n == 0 ? 0.5f : 1.0f);
+            const auto twDown = 0.12f * (n == 0 ? 0.5f : 1.0f);
+            const auto dBUp = -75.0f + 10.0f * static_cast<float>(n);
+            const auto dBDown = -70.0f + 10.0f * static_cast<float>(n);
+
+            auto& stage = d.stages[static_cast<size_t>(n)];
+
+            auto load = [](const auto& structure, std::array<SampleType, maxAllpasses>& coefficients,
+                           int& numAllpasses, int& numDirect)
+            {
+                // The delayed path opens with a plain unit delay, which has
+                // no coefficient of its own
+                jassert(structure.directPath.size() + structure.delayedPath.size() - 1 <= maxAllpasses);
+                numAllpasses = 0;
+
+                for (int i = 0; i < structure.directPath.size(); ++i)
+                    coefficients[static_cast<size_t>(numAllpasses++)] = structure.directPath[i]->coefficients[0];
+
+                numDirect = numAllpasses;
+
+                for (int i = 1; i < structure.delayedPath.size(); ++i)
+                    coefficients[static_cast<size_t>(numAllpasses++)] = structure.delayedPath[i]->coefficients[0];
+            };
+
+            using FilterDesign = juce::dsp::FilterDesign<SampleType>;
+            load(FilterDesign::designIIRLowpassHalfBandPolyphaseAllpassMethod(static_cast<SampleType>(twUp),
+                                                                              static_cast<SampleType>(dBUp)),
+                 stage.up, stage.numUp, stage.numDirectUp);
+            load(FilterDesign::designIIRLowpassHalfBandPolyphaseAllpassMethod(static_cast<SampleType>(twDown),
+                                                                              static_cast<SampleType>(dBDown)),
+                 stage.down, stage.numDown, stage.numDirectDown);
+
+            const juce::dsp::Oversampling<SampleType> reference(1, static_cast<size_t>(n + 1),
+                                                                juce::dsp::Oversampling<SampleType>::filterHalfBandPolyphaseIIR,
+                                                                true);
+            d.uncompensatedLatency[static_cast<size_t>(n)] = reference.getLatencyInSamples();
+        }
+
+        return d;
+    }();
+
+    return shared;
+}
+
+template class PolyphaseIIR<float>;
+template class PolyphaseIIR<double>;
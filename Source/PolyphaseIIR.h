@@ -0,0 +1,226 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+#include <array>
+#include <vector>
+
+// Half-band polyphase IIR oversampler with the filters, latency and integer
+// latency compensation of juce::dsp::Oversampling's polyphase IIR at
+// maximum quality, built so that the processing at the oversampled rate
+// runs inside it.
+//
+// process() works through a block in tiles of at most tileLength
+// oversampled samples. Each tile is interpolated through every stage,
+// handed to the caller's shaper and decimated back before the next tile
+// starts, so the oversampled signal never exists for more than one tile
+// and stays in L1 cache from interpolation to decimation. The recursions
+// are JUCE's, operation for operation, and are written once for a sample
+// type T: a scalar runs one channel, SIMDRegister one channel per lane.
+template <typename SampleType>
+class PolyphaseIIR
+{
+public:
+    static constexpr int maxStages = 4;       // up to 16x
+    static constexpr int maxAllpasses = 8;    // per stage and direction
+    static constexpr int tileLength = 256;
+
+    // Filter state of one channel, or of one channel per lane when T is a
+    // SIMDRegister
+    template <typename T>
+    struct State
+    {
+        std::array<std::array<T, maxAllpasses>, maxStages> up {};
+        std::array<std::array<T, maxAllpasses>, maxStages> down {};
+        std::array<T, maxStages> downDelay {};
+
+        // Thiran allpass of the integer latency compensation
+        T delayInput {};
+        T delayOutput {};
+    };
+
+    PolyphaseIIR(int numStages, int numChannels);
+
+    int getNumStages() const { return numStages; }
+    int getFactor() const { return 1 << numStages; }
+
+    // Whole samples, as juce::dsp::Oversampling reports with integer
+    // latency on
+    SampleType getLatencyInSamples() const { return latency; }
+
+    void reset();
+
+    State<SampleType>& getState(int channel) { return channels[static_cast<size_t>(channel)]; }
+    const State<SampleType>& getState(int channel) const { return channels[static_cast<size_t>(channel)]; }
+
+    // Flushes allpass state that has decayed into the denormal range, as
+    // juce::dsp::Oversampling does after each block
+    static void snapToZero(State<SampleType>& state);
+
+    // Upsamples numSamples host-rate samples, calls shape(data, first,
+    // length) on each tile of length oversampled samples starting at
+    // oversampled position first, and writes the decimated result to
+    // output, which may be input. tiles holds 2 * tileLength values of T
+    // and must be SIMD-aligned; the shaper always receives its start.
+    template <typename T, typename Shaper>
+    void process(const T* input, T* output, int numSamples, State<T>& state, T* tiles, Shaper&& shape) const;
+
+private:
+    // Allpass coefficients of one stage. Of each direction's list the first
+    // numDirect allpasses form the direct path, the rest the delayed path.
+    struct StageCoefficients
+    {
+        std::array<SampleType, maxAllpasses> up {}, down {};
+        int numUp = 0, numDown = 0;
+        int numDirectUp = 0, numDirectDown = 0;
+    };
+
+    // Stage n is the same whatever the stage count, so every count shares
+    // one design, made once per process
+    struct Design
+    {
+        std::array<StageCoefficients, maxStages> stages;
+        std::array<SampleType, maxStages> uncompensatedLatency {};   // per stage count
+    };
+
+    static const Design& getDesign();
+
+    template <typename T>
+    static void upsample(const StageCoefficients& c, T* v, const T* input, T* output, int numSamples);
+
+    template <typename T>
+    static void downsample(const StageCoefficients& c, T* v, T& delay, const T* input, T* output, int numSamples);
+
+    const Design& design;
+    int numStages = 1;
+    SampleType latency = 0;
+    SampleType fractionalDelay = 0;
+    SampleType delayCoefficient = 0;
+
+    std::vector<State<SampleType>> channels;
+
+    JUCE_DECLARE_NON_COPYABLE(PolyphaseIIR)
+};
+
+//==============================================================================
+// The kernels are templates on the lane type, so they live in the header.
+
+template <typename SampleType>
+template <typename T>
+void PolyphaseIIR<SampleType>::upsample(const StageCoefficients& c, T* v, const T* input, T* output, int numSamples)
+{
+    for (int i = 0; i < numSamples; ++i)
+    {
+        // Direct path to the even output, delayed path to the odd one
+        T x = input[i];
+        for (int k = 0; k < c.numDirectUp; ++k)
+        {
+            const T y = x * c.up[static_cast<size_t>(k)] + v[k];
+            v[k] = x - y * c.up[static_cast<size_t>(k)];
+            x = y;
+        }
+        output[2 * i] = x;
+
+        x = input[i];
+        for (int k = c.numDirectUp; k < c.numUp; ++k)
+        {
+            const T y = x * c.up[static_cast<size_t>(k)] + v[k];
+            v[k] = x - y * c.up[static_cast<size_t>(k)];
+            x = y;
+        }
+        output[2 * i + 1] = x;
+    }
+}
+
+// Runs in place as well: output[i] is written after input[2 i + 1] is read
+template <typename SampleType>
+template <typename T>
+void PolyphaseIIR<SampleType>::downsample(const StageCoefficients& c, T* v, T& delay, const T* input, T* output, int numSamples)
+{
+    T d = delay;
+
+    for (int i = 0; i < numSamples; ++i)
+    {
+        T x = input[2 * i];
+        for (int k = 0; k < c.numDirectDown; ++k)
+        {
+            const T y = x * c.down[static_cast<size_t>(k)] + v[k];
+            v[k] = x - y * c.down[static_cast<size_t>(k)];
+            x = y;
+        }
+        const T direct = x;
+
+        x = input[2 * i + 1];
+        for (int k = c.numDirectDown; k < c.numDown; ++k)
+        {
+            const T y = x * c.down[static_cast<size_t>(k)] + v[k];
+            v[k] = x - y * c.down[static_cast<size_t>(k)];
+            x = y;
+        }
+
+        output[i] = (d + direct) * SampleType(0.5);
+        d = x;
+    }
+
+    delay = d;
+}
+
+template <typename SampleType>
+template <typename T, typename Shaper>
+void PolyphaseIIR<SampleType>::process(const T* input, T* output, int numSamples, State<T>& state,
+                                       T* tiles, Shaper&& shape) const
+{
+    const int factor = getFactor();
+    const int tileSamples = tileLength / factor;
+
+    // The last stage always writes to the first buffer
+    T* buffers[2] = { tiles, tiles + tileLength };
+
+    for (int first = 0; first < numSamples; first += tileSamples)
+    {
+        const int length = juce::jmin(tileSamples, numSamples - first);
+
+        const T* source = input + first;
+        int n = length;
+
+        for (int s = 0; s < numStages; ++s)
+        {
+            T* dest = buffers[(numStages - 1 - s) % 2];
+            upsample(design.stages[static_cast<size_t>(s)], state.up[static_cast<size_t>(s)].data(), source, dest, n);
+            source = dest;
+            n *= 2;
+        }
+
+        shape(buffers[0], first * factor, n);
+
+        for (int s = numStages; --s >= 0;)
+        {
+            n /= 2;
+            downsample(design.stages[static_cast<size_t>(s)], state.down[static_cast<size_t>(s)].data(),
+                       state.downDelay[static_cast<size_t>(s)], buffers[0], buffers[0], n);
+        }
+
+        // Thiran allpass up to the next whole sample:
+        // y[n] = x[n - 1] + alpha (x[n] - y[n - 1])
+        T* dest = output + first;
+
+        if (fractionalDelay > SampleType(0))
+        {
+            T x1 = state.delayInput, y1 = state.delayOutput;
+
+            for (int i = 0; i < length; ++i)
+            {
+                const T x = buffers[0][i];
+                y1 = x1 + (x - y1) * delayCoefficient;
+                x1 = x;
+                dest[i] = y1;
+            }
+
+            state.delayInput = x1;
+            state.delayOutput = y1;
+        }
+        else
+        {
+            std::copy_n(buffers[0], length, dest);
+        }
+    }
+}
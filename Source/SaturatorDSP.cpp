@@ -1,340 +1,2484 @@
 #include "SaturatorDSP.h"
 #include <cmath>
+#include <map>
+#include <mutex>
+
+#if SATURATOR_PROFILE_STAGES
+ #include "StageTrace.h"
+
+ // Charges the ticks since the previous lap to the given stage
+ #define SATURATOR_STAGE_LAP(stage) lapStage(Stage::stage);
+#else
+ #define SATURATOR_STAGE_LAP(stage)
+#endif
+
+namespace
+{
+    // Flushes filter state that has decayed into the denormal range
+    template <typename SampleType>
+    SampleType snapToZero(SampleType x)
+    {
+        constexpr auto floor = static_cast<SampleType>(1.0e-8);
+        return (x < -floor || x > floor) ? x : SampleType(0);
+    }
+
+    // Samples until a biquad's impulse response has decayed by the given
+    // factor, from its slowest pole
+    template <typename Coefficients>
+    double biquadDecaySamples(const Coefficients& c, double decay)
+    {
+        const auto a1 = static_cast<double>(c[3]);
+        const auto a2 = static_cast<double>(c[4]);
+        const double disc = a1 * a1 - 4.0 * a2;
+
+        const double radius = disc < 0.0
+            ? std::sqrt(a2)
+            : juce::jmax(std::abs(-a1 + std::sqrt(disc)), std::abs(-a1 - std::sqrt(disc))) * 0.5;
+
+        if (radius <= 0.0)
+            return 2.0;
+
+        jassert(radius < 1.0);
+        return std::log(decay) / std::log(radius);
+    }
+
+    // dest[i] = start + (end - start) * (first + i + 1) / total: samples
+    // [first, first + numSamples) of a ramp over total samples
+    template <typename SampleType>
+    void fillRamp(SampleType* dest, int first, int numSamples, int total, SampleType start, SampleType end)
+    {
+        const SampleType step = (end - start) / static_cast<SampleType>(total);
+        for (int i = 0; i < numSamples; ++i)
+            dest[i] = start + step * static_cast<SampleType>(first + i + 1);
+    }
+
+    // dest[i] = start + (end - start) * (i + 1) / numSamples
+    template <typename SampleType>
+    void fillRamp(SampleType* dest, int numSamples, SampleType start, SampleType end)
+    {
+        fillRamp(dest, 0, numSamples, numSamples, start, end);
+    }
+
+    // The part of a block ramp that covers samples [first, first + length)
+    // of total, on the same line as the whole ramp
+    SaturatorDSPBase::Ramp sliceRamp(const SaturatorDSPBase::Ramp& ramp, int first, int length, int total)
+    {
+        if (ramp.isConstant())
+            return ramp;
+
+        auto valueAt = [&ramp, total](int position)
+        {
+            if (position == total)
+                return ramp.end;
+
+            return ramp.start + (ramp.end - ramp.start) * static_cast<float>(position) / static_cast<float>(total);
+        };
+
+        return { valueAt(first), valueAt(first + length) };
+    }
+
+    SaturatorDSPBase::Parameters sliceParameters(const SaturatorDSPBase::Parameters& params,
+                                                 int first, int length, int total)
+    {
+        SaturatorDSPBase::Parameters slice;
+        slice.inputTrimDb = sliceRamp(params.inputTrimDb, first, length, total);
+        slice.driveDb = sliceRamp(params.driveDb, first, length, total);
+        slice.bias = sliceRamp(params.bias, first, length, total);
+        slice.sagAmount = sliceRamp(params.sagAmount, first, length, total);
+        slice.outputTrimDb = sliceRamp(params.outputTrimDb, first, length, total);
+        slice.mix = sliceRamp(params.mix, first, length, total);
+
+        slice.numBands = params.numBands;
+        slice.lowCrossoverHz = params.lowCrossoverHz;
+        slice.highCrossoverHz = params.highCrossoverHz;
+
+        for (size_t b = 0; b < params.bands.size(); ++b)
+        {
+            slice.bands[b].driveDb = sliceRamp(params.bands[b].driveDb, first, length, total);
+            slice.bands[b].bias = sliceRamp(params.bands[b].bias, first, length, total);
+            slice.bands[b].sagAmount = sliceRamp(params.bands[b].sagAmount, first, length, total);
+        }
+
+        return slice;
+    }
+
+    //==========================================================================
+    // Channel lanes
+    //
+    // The kernels below are written once for a sample type T: a scalar runs
+    // a single channel, SIMDRegister runs one channel per lane over
+    // interleaved data. Only +, -, * and the helpers here are used, so both
+    // produce the same numbers per channel.
+
+    // The scalar type of T and the number of channels one T carries
+    template <typename T>
+    struct Lanes
+    {
+        using Scalar = T;
+        static constexpr size_t count = 1;
+    };
+
+   #if JUCE_USE_SIMD
+    template <typename S>
+    struct Lanes<juce::dsp::SIMDRegister<S>>
+    {
+        using Scalar = S;
+        static constexpr size_t count = juce::dsp::SIMDRegister<S>::SIMDNumElements;
+    };
+   #endif
+
+    template <typename T>
+    using ScalarOf = typename Lanes<T>::Scalar;
+
+    template <typename T>
+    constexpr size_t lanesIn = Lanes<T>::count;
+
+    template <typename S>
+    void setLane(S& r, size_t, S value) { r = value; }
+
+    template <typename S>
+    S getLane(S r, size_t) { return r; }
+
+   #if JUCE_USE_SIMD
+    template <typename S>
+    void setLane(juce::dsp::SIMDRegister<S>& r, size_t lane, S value) { r.set(lane, value); }
+
+    template <typename S>
+    S getLane(const juce::dsp::SIMDRegister<S>& r, size_t lane) { return r.get(lane); }
+   #endif
+
+    // Copies numChannels channels into dest with the given lane stride,
+    // zero-filling the unused lanes
+    template <typename S>
+    void interleave(S* const* channels, int numChannels, int numSamples, size_t stride, S* dest)
+    {
+        if (static_cast<size_t>(numChannels) < stride)
+            std::fill_n(dest, static_cast<size_t>(numSamples) * stride, S(0));
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const S* src = channels[ch];
+            S* lane = dest + ch;
+            for (int i = 0; i < numSamples; ++i)
+                lane[static_cast<size_t>(i) * stride] = src[i];
+        }
+    }
+
+    template <typename S>
+    void deinterleave(const S* src, int numChannels, int numSamples, size_t stride, S* const* channels)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            const S* lane = src + ch;
+            S* dest = channels[ch];
+            for (int i = 0; i < numSamples; ++i)
+                dest[i] = lane[static_cast<size_t>(i) * stride];
+        }
+    }
+
+    // Filter state of a chain kernel while it runs
+    template <typename T>
+    struct ChainRegisters
+    {
+        T dcX1, dcY1;
+        std::array<T, 6> biquad;   // s1, s2 of each section
+    };
+
+    template <typename T, typename Blocker, typename Cascade>
+    ChainRegisters<T> gatherChain(const Blocker* dc, const Cascade* state, int numChannels)
+    {
+        using S = ScalarOf<T>;
+        ChainRegisters<T> r;
+
+        for (size_t lane = 0; lane < lanesIn<T>; ++lane)
+        {
+            const bool used = lane < static_cast<size_t>(numChannels);
+            setLane(r.dcX1, lane, used ? dc[lane].x1 : S(0));
+            setLane(r.dcY1, lane, used ? dc[lane].y1 : S(0));
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                setLane(r.biquad[2 * k],     lane, used ? state[lane][k].s1 : S(0));
+                setLane(r.biquad[2 * k + 1], lane, used ? state[lane][k].s2 : S(0));
+            }
+        }
+
+        return r;
+    }
+
+    template <typename T, typename Blocker, typename Cascade>
+    void scatterChain(const ChainRegisters<T>& r, Blocker* dc, Cascade* state, int numChannels)
+    {
+        for (size_t lane = 0; lane < static_cast<size_t>(numChannels); ++lane)
+        {
+            dc[lane].x1 = getLane(r.dcX1, lane);
+            dc[lane].y1 = snapToZero(getLane(r.dcY1, lane));
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                state[lane][k].s1 = snapToZero(getLane(r.biquad[2 * k], lane));
+                state[lane][k].s2 = snapToZero(getLane(r.biquad[2 * k + 1], lane));
+            }
+        }
+    }
+
+    // Polyphase oversampler state of a channel group, one channel per lane
+    template <typename T>
+    using PolyphaseState = typename PolyphaseIIR<ScalarOf<T>>::template State<T>;
+
+    template <typename T>
+    PolyphaseState<T> gatherPolyphase(const PolyphaseIIR<ScalarOf<T>>& oversampler, int first, int numChannels)
+    {
+        using S = ScalarOf<T>;
+        const auto numStages = static_cast<size_t>(oversampler.getNumStages());
+        PolyphaseState<T> r;
+
+        for (size_t lane = 0; lane < lanesIn<T>; ++lane)
+        {
+            const bool used = lane < static_cast<size_t>(numChannels);
+            const auto& state = oversampler.getState(used ? first + static_cast<int>(lane) : first);
+
+            for (size_t s = 0; s < numStages; ++s)
+            {
+                for (size_t k = 0; k < state.up[s].size(); ++k)
+                {
+                    setLane(r.up[s][k],   lane, used ? state.up[s][k] : S(0));
+                    setLane(r.down[s][k], lane, used ? state.down[s][k] : S(0));
+                }
+
+                setLane(r.downDelay[s], lane, used ? state.downDelay[s] : S(0));
+            }
+
+            setLane(r.delayInput,  lane, used ? state.delayInput : S(0));
+            setLane(r.delayOutput, lane, used ? state.delayOutput : S(0));
+        }
+
+        return r;
+    }
+
+    template <typename T>
+    void scatterPolyphase(const PolyphaseState<T>& r, PolyphaseIIR<ScalarOf<T>>& oversampler, int first, int numChannels)
+    {
+        const auto numStages = static_cast<size_t>(oversampler.getNumStages());
+
+        for (size_t lane = 0; lane < static_cast<size_t>(numChannels); ++lane)
+        {
+            auto& state = oversampler.getState(first + static_cast<int>(lane));
+
+            for (size_t s = 0; s < numStages; ++s)
+            {
+                for (size_t k = 0; k < state.up[s].size(); ++k)
+                {
+                    state.up[s][k] = getLane(r.up[s][k], lane);
+                    state.down[s][k] = getLane(r.down[s][k], lane);
+                }
+
+                state.downDelay[s] = getLane(r.downDelay[s], lane);
+            }
+
+            state.delayInput = getLane(r.delayInput, lane);
+            state.delayOutput = getLane(r.delayOutput, lane);
+
+            PolyphaseIIR<ScalarOf<T>>::snapToZero(state);
+        }
+    }
+
+    // Input trim -> DC blocker -> HPF -> mid boost -> HF shelf
+    template <typename T, typename Coefficients>
+    void runPreChain(T* data, int numSamples, const ScalarOf<T>* gains, ScalarOf<T> gain, ScalarOf<T> dcCoeff,
+                     const Coefficients& c, ChainRegisters<T>& r)
+    {
+        const auto& c0 = c[0];
+        const auto& c1 = c[1];
+        const auto& c2 = c[2];
+
+        T dcX1 = r.dcX1, dcY1 = r.dcY1;
+        T s01 = r.biquad[0], s02 = r.biquad[1];
+        T s11 = r.biquad[2], s12 = r.biquad[3];
+        T s21 = r.biquad[4], s22 = r.biquad[5];
+
+        auto run = [&](auto gainAt)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                T x = data[i] * gainAt(i);
+
+                // y[n] = x[n] - x[n-1] + R * y[n-1]
+                T y = x - dcX1 + dcY1 * dcCoeff;
+                dcX1 = x;
+                dcY1 = y;
+
+                x = y;
+                y = x * c0[0] + s01;
+                s01 = x * c0[1] - y * c0[3] + s02;
+                s02 = x * c0[2] - y * c0[4];
+
+                x = y;
+                y = x * c1[0] + s11;
+                s11 = x * c1[1] - y * c1[3] + s12;
+                s12 = x * c1[2] - y * c1[4];
+
+                x = y;
+                y = x * c2[0] + s21;
+                s21 = x * c2[1] - y * c2[3] + s22;
+                s22 = x * c2[2] - y * c2[4];
+
+                data[i] = y;
+            }
+        };
+
+        if (gains != nullptr)
+            run([gains](int i) { return gains[i]; });
+        else
+            run([gain](int) { return gain; });
+
+        r = { dcX1, dcY1, { s01, s02, s11, s12, s21, s22 } };
+    }
+
+    // LPF -> low shelf -> presence dip -> DC blocker -> output trim
+    template <typename T, typename Coefficients>
+    void runPostChain(T* data, int numSamples, const ScalarOf<T>* gains, ScalarOf<T> gain, ScalarOf<T> dcCoeff,
+                      const Coefficients& c, ChainRegisters<T>& r)
+    {
+        const auto& c0 = c[0];
+        const auto& c1 = c[1];
+        const auto& c2 = c[2];
+
+        T dcX1 = r.dcX1, dcY1 = r.dcY1;
+        T s01 = r.biquad[0], s02 = r.biquad[1];
+        T s11 = r.biquad[2], s12 = r.biquad[3];
+        T s21 = r.biquad[4], s22 = r.biquad[5];
+
+        auto run = [&](auto gainAt)
+        {
+            for (int i = 0; i < numSamples; ++i)
+            {
+                T x = data[i];
+                T y = x * c0[0] + s01;
+                s01 = x * c0[1] - y * c0[3] + s02;
+                s02 = x * c0[2] - y * c0[4];
+
+                x = y;
+                y = x * c1[0] + s11;
+                s11 = x * c1[1] - y * c1[3] + s12;
+                s12 = x * c1[2] - y * c1[4];
+
+                x = y;
+                y = x * c2[0] + s21;
+                s21 = x * c2[1] - y * c2[3] + s22;
+                s22 = x * c2[2] - y * c2[4];
+
+                x = y;
+                y = x - dcX1 + dcY1 * dcCoeff;
+                dcX1 = x;
+                dcY1 = y;
+
+                data[i] = y * gainAt(i);
+            }
+        };
+
+        if (gains != nullptr)
+            run([gains](int i) { return gains[i]; });
+        else
+            run([gain](int) { return gain; });
+
+        r = { dcX1, dcY1, { s01, s02, s11, s12, s21, s22 } };
+    }
+
+    // Samples [first, first + length) of the sag gain ramp over total
+    // samples. Segment j is segmentLength samples long (the last one may be
+    // shorter) and ramps linearly from gains[j] to gains[j + 1].
+    template <typename T>
+    void fillSagRamp(T* dest, int first, int length, int segmentLength, int total, const T* gains)
+    {
+        using S = ScalarOf<T>;
+
+        for (int i = first; i < first + length;)
+        {
+            const int segment = i / segmentLength;
+            const int start = segment * segmentLength;
+            const int end = juce::jmin(start + segmentLength, total);
+            const int stop = juce::jmin(end, first + length);
+
+            const T from = gains[segment];
+            const T step = (gains[segment + 1] - from) * (S(1) / static_cast<S>(end - start));
+
+            for (; i < stop; ++i)
+                dest[i - first] = from + step * static_cast<S>(i - start + 1);
+        }
+    }
+
+    // (x + bias) * drive * sag gain. Every term is element-wise, so the
+    // loop vectorises across samples as well as lanes.
+    template <typename T>
+    void runDrive(T* data, int numSamples, const T* sagGain, const ScalarOf<T>* bias, const ScalarOf<T>* drive)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = sagGain[i] * ((data[i] + bias[i]) * drive[i]);
+    }
+}
 
 //==============================================================================
 // DC Blocker — one-pole HPF
 //==============================================================================
 
-void SaturatorDSP::DCBlocker::prepare(double sampleRate)
-{
-    const double fc = 5.0;
-    coeff = static_cast<float>(1.0 - (2.0 * juce::MathConstants<double>::pi * fc / sampleRate));
-    reset();
-}
+template <typename SampleType>
+void SaturatorDSP<SampleType>::DCBlocker::prepare(double sampleRate)
+{
+    const double fc = 5.0;
+    coeff = static_cast<SampleType>(1.0 - (2.0 * juce::MathConstants<double>::pi * fc / sampleRate));
+    reset();
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::DCBlocker::reset()
+{
+    x1 = 0;
+    y1 = 0;
+}
+
+//==============================================================================
+// Dry Delay — latency-matched ring buffer
+//==============================================================================
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::DryDelay::prepare(int numChannels, int maxBlockSize, int maxDelay)
+{
+    maxHistory = maxDelay;
+    const int size = juce::nextPowerOfTwo(maxBlockSize + maxHistory);
+
+    ring.setSize(numChannels, size);
+    mask = size - 1;
+    delay = 0;
+    reset();
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::DryDelay::reset()
+{
+    ring.clear();
+    writePosition = 0;
+    blockStart = 0;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::DryDelay::setDelay(int delayInSamples)
+{
+    jassert(delayInSamples >= 0 && delayInSamples <= maxHistory);
+    delay = delayInSamples;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::DryDelay::push(const juce::AudioBuffer<SampleType>& input, bool historyOnly)
+{
+    const int numSamples = input.getNumSamples();
+    const int skip = historyOnly ? juce::jmax(0, numSamples - maxHistory) : 0;
+    const int size = mask + 1;
+
+    blockStart = writePosition;
+
+    for (int ch = 0; ch < juce::jmin(input.getNumChannels(), ring.getNumChannels()); ++ch)
+    {
+        const int start = (writePosition + skip) & mask;
+        const int count = numSamples - skip;
+        const int first = juce::jmin(count, size - start);
+        const auto* src = input.getReadPointer(ch, skip);
+
+        ring.copyFrom(ch, start, src, first);
+        if (first < count)
+            ring.copyFrom(ch, 0, src + first, count - first);
+    }
+
+    writePosition = (writePosition + numSamples) & mask;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::DryDelay::addDelayed(int channel, SampleType* dest, int numSamples, SampleType gain) const
+{
+    const int size = mask + 1;
+    const auto* data = ring.getReadPointer(channel);
+
+    const int start = (blockStart - delay) & mask;
+    const int first = juce::jmin(numSamples, size - start);
+
+    juce::FloatVectorOperations::addWithMultiply(dest, data + start, gain, first);
+    if (first < numSamples)
+        juce::FloatVectorOperations::addWithMultiply(dest + first, data, gain, numSamples - first);
+}
+
+//==============================================================================
+// Envelope Follower for Sag
+//==============================================================================
+
+// The envelope runs at the host rate, so every path of every quality
+// shares the same coefficients
+template <typename SampleType>
+void SaturatorDSP<SampleType>::EnvelopeFollower::prepare(double sampleRate)
+{
+    attackCoeff = static_cast<SampleType>(1.0 - std::exp(-1.0 / (sampleRate * 0.008)));
+    releaseCoeff = static_cast<SampleType>(1.0 - std::exp(-1.0 / (sampleRate * 0.200)));
+    rmsCoeff = static_cast<SampleType>(1.0 - std::exp(-1.0 / (sampleRate * 0.010)));
+    reset();
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::EnvelopeFollower::reset()
+{
+    envelope = 0;
+    meanSquare = 0;
+    gain = 1;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setSagDetection(SagDetector detector, bool linked)
+{
+    sagDetector = detector;
+    sagLinked = linked;
+}
+
+// Follows the band's host-rate input and writes each channel's sag gain,
+// 1 - sag * envelope, at the control points into the band's scratch: entry
+// 0 is the gain the previous block ended on, entry j the gain at the end of
+// control segment j. Linked channels follow the loudest channel together.
+template <typename SampleType>
+void SaturatorDSP<SampleType>::runSagDetector(Path& path, const juce::AudioBuffer<SampleType>& buffer,
+                                              const Ramp& sagAmount)
+{
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = buffer.getNumChannels();
+    const int numSegments = (numSamples + sagControlInterval - 1) / sagControlInterval;
+    auto& gains = getScratch(path.band).sagGains;
+
+    const auto sagStart = static_cast<SampleType>(sagAmount.start);
+    const auto sagStep = static_cast<SampleType>(sagAmount.end - sagAmount.start) / static_cast<SampleType>(numSamples);
+
+    // The envelope follows the rectified input, or for RMS the root of its
+    // mean square over a 10 ms window. input(i) returns |x| for sample i.
+    auto follow = [&](auto rms, auto&& input, EnvelopeFollower& env, SampleType* out)
+    {
+        constexpr bool isRMS = decltype(rms)::value;
+        SampleType level = env.envelope;
+        SampleType meanSquare = env.meanSquare;
+        out[0] = env.gain;
+
+        for (int segment = 0; segment < numSegments; ++segment)
+        {
+            const int end = juce::jmin(numSamples, (segment + 1) * sagControlInterval);
+
+            for (int i = segment * sagControlInterval; i < end; ++i)
+            {
+                SampleType detected = input(i);
+
+                if constexpr (isRMS)
+                {
+                    meanSquare += (detected * detected - meanSquare) * env.rmsCoeff;
+                    detected = std::sqrt(meanSquare);
+                }
+
+                level += (detected - level) * (detected > level ? env.attackCoeff : env.releaseCoeff);
+            }
+
+            out[segment + 1] = SampleType(1) - (sagStart + sagStep * static_cast<SampleType>(end)) * level;
+        }
+
+        env.envelope = level;
+        env.meanSquare = meanSquare;
+        env.gain = out[numSegments];
+    };
+
+    auto run = [&](auto rms)
+    {
+        if (! sagLinked || numChannels == 1)
+        {
+            for (int ch = 0; ch < numChannels; ++ch)
+            {
+                const auto* data = buffer.getReadPointer(ch);
+                follow(rms, [data](int i) { return std::abs(data[i]); },
+                       path.sagEnvelope[static_cast<size_t>(ch)], gains.data() + ch * sagGainStride);
+            }
+
+            return;
+        }
+
+        // Linking may just have been switched on, so the shared envelope
+        // starts from the most compressed channel
+        auto& linked = path.sagEnvelope.front();
+        for (int ch = 1; ch < numChannels; ++ch)
+        {
+            const auto& env = path.sagEnvelope[static_cast<size_t>(ch)];
+            if (env.envelope > linked.envelope)
+            {
+                linked.envelope = env.envelope;
+                linked.gain = env.gain;
+            }
+
+            linked.meanSquare = juce::jmax(linked.meanSquare, env.meanSquare);
+        }
+
+        auto* const* channels = buffer.getArrayOfReadPointers();
+        follow(rms, [channels, numChannels](int i)
+        {
+            SampleType peak = 0;
+            for (int ch = 0; ch < numChannels; ++ch)
+                peak = juce::jmax(peak, std::abs(channels[ch][i]));
+            return peak;
+        }, linked, gains.data());
+
+        for (int ch = 1; ch < numChannels; ++ch)
+        {
+            path.sagEnvelope[static_cast<size_t>(ch)] = linked;
+            std::copy(gains.data(), gains.data() + numSegments + 1, gains.data() + ch * sagGainStride);
+        }
+    };
+
+    if (sagDetector == SagDetector::RMS)
+        run(std::true_type());
+    else
+        run(std::false_type());
+}
+
+//==============================================================================
+// Valve Shaper
+//==============================================================================
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setShaperKernel(ValveShaper::Kernel kernel)
+{
+    shaperKernel = kernel;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setSubBlockSize(int samples)
+{
+    subBlockSize = juce::jlimit(minSubBlockSize, maxSubBlockSize, samples);
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setThreadCount(int numThreads)
+{
+    threadCount = juce::jlimit(1, maxBands, numThreads);
+}
+
+// Short sub-blocks cost less than the handoff. Stage timers are not
+// thread-safe, so a profiled or traced run stays serial.
+template <typename SampleType>
+bool SaturatorDSP<SampleType>::runsBandsInParallel(int numSamples) const
+{
+   #if SATURATOR_PROFILE_STAGES
+    if (stageProfile != nullptr || stageTrace != nullptr)
+        return false;
+   #endif
+
+    return workerPool != nullptr && threadCount > 1 && numSamples >= minParallelSamples;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setMeters(Meters* metersToUse)
+{
+    meters = metersToUse;
+}
+
+const char* SaturatorDSPBase::getStageName(Stage stage)
+{
+    switch (stage)
+    {
+        case Stage::DryCopy:       return "dryCopy";
+        case Stage::PreChain:      return "preChain";
+        case Stage::Upsample:      return "upsample";
+        case Stage::ValveStage:    return "valveStage";
+        case Stage::Downsample:    return "downsample";
+        case Stage::PostChain:     return "postChain";
+        case Stage::Mix:           return "mix";
+        case Stage::numStages:
+        default:                   return "";
+    }
+}
+
+#if SATURATOR_PROFILE_STAGES
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setStageProfile(StageProfile* profileToUse)
+{
+    stageProfile = profileToUse;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setStageTrace(StageTrace* traceToUse)
+{
+    stageTrace = traceToUse;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::lapStage(Stage stage)
+{
+    if (stageProfile == nullptr && stageTrace == nullptr)
+        return;
+
+    const auto now = juce::Time::getHighResolutionTicks();
+
+    if (stageProfile != nullptr)
+        stageProfile->ticks[static_cast<size_t>(stage)] += now - lapStart;
+
+    if (stageTrace != nullptr)
+        stageTrace->push({ lapStart, now, static_cast<int>(stage), 0 });
+
+    lapStart = now;
+}
+#endif
+
+//==============================================================================
+// Oversampling Selection
+//==============================================================================
+
+// The slot of a band's oversampler of the given factor, -1 for 1x
+template <typename SampleType>
+int SaturatorDSP<SampleType>::getOversamplerSlot(int band, int factor)
+{
+    int stages = 0;
+
+    switch (factor)
+    {
+        case 2:  stages = 1; break;
+        case 4:  stages = 2; break;
+        case 8:  stages = 3; break;
+        case 16: stages = 4; break;
+        default: return -1;
+    }
+
+    return band * maxStages + stages - 1;
+}
+
+template <typename SampleType>
+PolyphaseIIR<SampleType>* SaturatorDSP<SampleType>::getPolyphaseOversampler(int band, int factor) const
+{
+    const int slot = getOversamplerSlot(band, factor);
+    return slot >= 0 ? polyphaseOversamplers[static_cast<size_t>(slot)].get() : nullptr;
+}
+
+template <typename SampleType>
+juce::dsp::Oversampling<SampleType>* SaturatorDSP<SampleType>::getHalfBandOversampler(int band, int factor) const
+{
+    const int slot = getOversamplerSlot(band, factor);
+    return slot >= 0 ? halfBandOversamplers[static_cast<size_t>(slot)].get() : nullptr;
+}
+
+template <typename SampleType>
+bool SaturatorDSP<SampleType>::hasOversampler(int band, int factor, Filter filter) const
+{
+    return filter == Filter::PolyphaseIIR ? getPolyphaseOversampler(band, factor) != nullptr
+                                          : getHalfBandOversampler(band, factor) != nullptr;
+}
+
+// Oversamplers run with integer latency, so paths can be padded exactly.
+// Every band's oversampler of a factor and filter has the same latency.
+template <typename SampleType>
+int SaturatorDSP<SampleType>::getPathLatency(int factor, Filter filter) const
+{
+    for (int band = 0; band < maxBands; ++band)
+    {
+        if (filter == Filter::PolyphaseIIR)
+        {
+            if (auto* oversampler = getPolyphaseOversampler(band, factor))
+                return juce::roundToInt(oversampler->getLatencyInSamples());
+        }
+        else if (auto* oversampler = getHalfBandOversampler(band, factor))
+        {
+            return juce::roundToInt(oversampler->getLatencyInSamples());
+        }
+    }
+
+    return 0;
+}
+
+// The longest path delay of any mode at this quality
+template <typename SampleType>
+int SaturatorDSP<SampleType>::getAlignedPathLatency(QualitySetting quality) const
+{
+    int latency = 0;
+    for (int m = 0; m < numModes; ++m)
+        latency = juce::jmax(latency, getPathLatency(getOversamplingFactor(static_cast<Mode>(m), quality.quality),
+                                                     quality.filter));
+
+    return latency;
+}
+
+// True when every band of every mode of the setting has its oversampler
+template <typename SampleType>
+bool SaturatorDSP<SampleType>::isBuilt(QualitySetting quality, int numBands) const
+{
+    for (int m = 0; m < numModes; ++m)
+    {
+        for (int band = 0; band < numBands; ++band)
+        {
+            const int factor = getBandFactor(static_cast<Mode>(m), quality.quality, band, numBands);
+            if (factor > 1 && ! hasOversampler(band, factor, quality.filter))
+                return false;
+        }
+    }
+
+    return true;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::buildOversamplers(QualitySetting quality, int numBands)
+{
+    using OversamplingType = juce::dsp::Oversampling<SampleType>;
+
+    for (int m = 0; m < numModes; ++m)
+    {
+        for (int band = 0; band < numBands; ++band)
+        {
+            const int factor = getBandFactor(static_cast<Mode>(m), quality.quality, band, numBands);
+            if (factor == 1 || hasOversampler(band, factor, quality.filter))
+                continue;
+
+            const auto stages = juce::roundToInt(std::log2(factor));
+            const auto slot = static_cast<size_t>(getOversamplerSlot(band, factor));
+
+            if (quality.filter == Filter::PolyphaseIIR)
+            {
+                polyphaseOversamplers[slot] = std::make_unique<PolyphaseIIR<SampleType>>(stages, currentNumChannels);
+                continue;
+            }
+
+            auto& oversampler = halfBandOversamplers[slot];
+            oversampler = std::make_unique<OversamplingType>(static_cast<size_t>(currentNumChannels),
+                                                             static_cast<size_t>(stages),
+                                                             OversamplingType::filterHalfBandFIREquiripple, true);
+            oversampler->setUsingIntegerLatency(true);
+            oversampler->initProcessing(static_cast<size_t>(currentBlockSize));
+        }
+    }
+}
+
+// The longest latency of any setting whose oversamplers are built
+template <typename SampleType>
+float SaturatorDSP<SampleType>::getMaxBuiltLatency() const
+{
+    float latency = 0.0f;
+
+    for (int f = 0; f < numFilters; ++f)
+    {
+        for (int q = 0; q < numQualities; ++q)
+        {
+            const QualitySetting setting { static_cast<Quality>(q), static_cast<Filter>(f) };
+
+            for (int numBands = 1; numBands <= maxBands; ++numBands)
+            {
+                if (isBuilt(setting, numBands))
+                {
+                    latency = juce::jmax(latency, getLatencyInSamples(setting));
+                    break;
+                }
+            }
+        }
+    }
+
+    return latency;
+}
+
+// The highest factor scratch has to hold a whole sub-block at: that of the
+// built FIR oversamplers, 1 if none is built. Polyphase IIR paths only ever
+// hold a tile at their rate.
+template <typename SampleType>
+int SaturatorDSP<SampleType>::getMaxBlockFactor() const
+{
+    int factor = 1;
+
+    for (size_t slot = 0; slot < halfBandOversamplers.size(); ++slot)
+        if (halfBandOversamplers[slot] != nullptr)
+            factor = juce::jmax(factor, 2 << (slot % maxStages));
+
+    return factor;
+}
+
+// Grows the dry and clean delays to the longest built latency and the
+// oversampled scratch to the highest FIR factor, and refreshes the tail
+template <typename SampleType>
+void SaturatorDSP<SampleType>::updateBuiltBounds()
+{
+    const auto maxDelay = static_cast<int>(std::ceil(getMaxBuiltLatency()));
+
+    if (maxDelay > dryDelayCapacity)
+    {
+        dryDelay.prepare(currentNumChannels, currentBlockSize, maxDelay);
+
+        if (preparedBands > 1)
+            for (int b = 0; b < preparedBands; ++b)
+                cleanDelays[static_cast<size_t>(b)].prepare(currentNumChannels, currentBlockSize, maxDelay);
+
+        dryDelayCapacity = maxDelay;
+    }
+
+    const int factor = getMaxBlockFactor();
+    if (factor > scratchFactor)
+        resizeScratch(factor);
+
+    tailSamples = computeTailSamples();
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::resizeScratch(int factor)
+{
+    constexpr auto tileLength = static_cast<size_t>(PolyphaseIIR<SampleType>::tileLength);
+    const auto length = static_cast<size_t>(currentBlockSize * factor);
+    const auto rampLength = juce::jmax(length, tileLength);
+    const int numSets = workerPool != nullptr ? preparedBands : 1;
+
+    for (int set = 0; set < numSets; ++set)
+    {
+        auto& work = scratch[static_cast<size_t>(set)];
+        work.lanes.assign(length * laneCount + ValveShaper::alignmentPadding, SampleType(0));
+        work.driveRamp.assign(rampLength, SampleType(0));
+        work.biasRamp.assign(rampLength, SampleType(0));
+        work.sagRamp.assign(rampLength * laneCount + ValveShaper::alignmentPadding, SampleType(0));
+        work.sagGains.assign(static_cast<size_t>(maxChannels * sagGainStride), SampleType(1));
+        work.tiles.assign(2 * tileLength * laneCount + ValveShaper::alignmentPadding, SampleType(0));
+        work.tileChannels.assign(tileLength * laneCount, SampleType(0));
+        work.transition.setSize(currentNumChannels, currentBlockSize);
+    }
+
+    scratchFactor = factor;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::buildQualitiesInUse()
+{
+    for (const auto& quality : qualitiesInUse)
+        buildOversamplers(quality, bandsInUse);
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setQualitiesInUse(const std::vector<QualitySetting>& qualities, int numBands)
+{
+    jassert(! qualities.empty());
+    qualitiesInUse = qualities.empty() ? std::vector<QualitySetting> { QualitySetting {} } : qualities;
+    bandsInUse = juce::jlimit(1, maxBands, numBands);
+
+    if (! prepared)
+        return;
+
+    buildQualitiesInUse();
+
+    if (bandsInUse > preparedBands)
+        prepareBands(bandsInUse);
+
+    updateBuiltBounds();
+}
+
+//==============================================================================
+// EQ Configuration
+//==============================================================================
+
+template <typename SampleType>
+typename SaturatorDSP<SampleType>::BiquadCoefficients SaturatorDSP<SampleType>::toBiquad(
+    const juce::dsp::IIR::Coefficients<SampleType>& coefficients)
+{
+    BiquadCoefficients c {};
+    std::copy_n(coefficients.coefficients.begin(), c.size(), c.begin());
+    return c;
+}
+
+template <typename SampleType>
+typename SaturatorDSP<SampleType>::EmphasisSet SaturatorDSP<SampleType>::designPreEmphasis(double sampleRate, Mode mode)
+{
+    SampleType hpfFreq = 60.0f;
+    SampleType midFreq = 1000.0f;
+    SampleType midGainDb = 6.0f;
+    SampleType midQ = 0.6f;
+    SampleType hfShelfFreq = 6000.0f;
+    SampleType hfShelfGainDb = 3.0f;
+
+    switch (mode)
+    {
+        case Mode::Triode:
+            midGainDb = 4.0f;
+            hfShelfGainDb = 2.0f;
+            break;
+        case Mode::Pentode:
+            midGainDb = 8.0f;
+            hfShelfGainDb = 3.0f;
+            break;
+        case Mode::Torture:
+            midGainDb = 6.0f;
+            hfShelfGainDb = 4.0f;
+            break;
+    }
+
+    return {
+        toBiquad(*juce::dsp::IIR::Coefficients<SampleType>::makeHighPass(
+            sampleRate, hpfFreq, SampleType(0.5))),
+
+        toBiquad(*juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter(
+            sampleRate, midFreq, midQ,
+            juce::Decibels::decibelsToGain(midGainDb))),
+
+        toBiquad(*juce::dsp::IIR::Coefficients<SampleType>::makeHighShelf(
+            sampleRate, hfShelfFreq, SampleType(0.7),
+            juce::Decibels::decibelsToGain(hfShelfGainDb)))
+    };
+}
+
+template <typename SampleType>
+typename SaturatorDSP<SampleType>::EmphasisSet SaturatorDSP<SampleType>::designPostEmphasis(double sampleRate, Mode mode)
+{
+    SampleType lpfFreq = 12000.0f;
+    SampleType lowShelfFreq = 120.0f;
+    SampleType lowShelfGainDb = 3.0f;
+    SampleType presenceDipFreq = 3000.0f;
+    SampleType presenceDipDb = -3.0f;
+
+    switch (mode)
+    {
+        case Mode::Triode:
+            lpfFreq = 14000.0f;
+            presenceDipDb = -2.0f;
+            lowShelfGainDb = 2.0f;
+            break;
+        case Mode::Pentode:
+            lpfFreq = 11000.0f;
+            presenceDipDb = -4.0f;
+            lowShelfGainDb = 3.5f;
+            break;
+        case Mode::Torture:
+            lpfFreq = 8000.0f;
+            presenceDipDb = -6.0f;
+            lowShelfGainDb = 4.0f;
+            break;
+    }
+
+    return {
+        toBiquad(*juce::dsp::IIR::Coefficients<SampleType>::makeLowPass(
+            sampleRate, lpfFreq, SampleType(0.7))),
+
+        toBiquad(*juce::dsp::IIR::Coefficients<SampleType>::makeLowShelf(
+            sampleRate, lowShelfFreq, SampleType(0.7),
+            juce::Decibels::decibelsToGain(lowShelfGainDb))),
+
+        toBiquad(*juce::dsp::IIR::Coefficients<SampleType>::makePeakFilter(
+            sampleRate, presenceDipFreq, SampleType(1),
+            juce::Decibels::decibelsToGain(presenceDipDb)))
+    };
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::setEmphasisMode(Mode mode)
+{
+    if (mode == emphasisMode)
+        return;
+
+    // Start from whatever is loaded now, so a mode change in the middle of
+    // a fade carries on smoothly
+    preEmphasisStart = preEmphasisCurrent;
+    postEmphasisStart = postEmphasisCurrent;
+
+    emphasisMode = mode;
+    emphasisFadePosition = 0;
+}
+
+// One set of tables per sample rate, shared by every instance at that rate
+// and freed with the last of them
+template <typename SampleType>
+std::shared_ptr<const typename SaturatorDSP<SampleType>::CoefficientTables>
+SaturatorDSP<SampleType>::getSharedTables(double sampleRate)
+{
+    static std::mutex cacheLock;
+    static std::map<double, std::weak_ptr<const CoefficientTables>> cache;
+
+    const std::lock_guard<std::mutex> lock(cacheLock);
+
+    if (auto existing = cache[sampleRate].lock())
+        return existing;
+
+    auto designed = std::make_shared<CoefficientTables>();
+
+    for (int m = 0; m < numModes; ++m)
+    {
+        designed->preEmphasis[static_cast<size_t>(m)] = designPreEmphasis(sampleRate, static_cast<Mode>(m));
+        designed->postEmphasis[static_cast<size_t>(m)] = designPostEmphasis(sampleRate, static_cast<Mode>(m));
+    }
+
+    // Drop the entries of rates no instance runs at any more
+    for (auto it = cache.begin(); it != cache.end();)
+        it = it->second.expired() ? cache.erase(it) : std::next(it);
+
+    cache[sampleRate] = designed;
+    return designed;
+}
+
+// Returns the length of the next chunk to process and, while a fade is
+// running, moves the current coefficients along it
+template <typename SampleType>
+int SaturatorDSP<SampleType>::advanceEmphasisFade(int maxChunk, int& fadePosition, EmphasisSet& current,
+                                                  const EmphasisSet& start, const EmphasisSet& target) const
+{
+    if (fadePosition >= emphasisFadeLength)
+        return maxChunk;
+
+    const int chunk = juce::jmin(maxChunk, emphasisFadeChunk);
+    fadePosition = juce::jmin(fadePosition + chunk, emphasisFadeLength);
+
+    if (fadePosition == emphasisFadeLength)
+    {
+        current = target;
+        return chunk;
+    }
+
+    const auto t = static_cast<SampleType>(fadePosition) / static_cast<SampleType>(emphasisFadeLength);
+
+    for (size_t stage = 0; stage < current.size(); ++stage)
+        for (size_t k = 0; k < current[stage].size(); ++k)
+            current[stage][k] = start[stage][k] + t * (target[stage][k] - start[stage][k]);
+
+    return chunk;
+}
+
+//==============================================================================
+// Fused Pre/Post Chains
+//==============================================================================
+
+template <typename SampleType>
+template <typename Convert>
+SampleType SaturatorDSP<SampleType>::GainCache::get(float dB, Convert convert)
+{
+    if (! juce::exactlyEqual(dB, db))
+    {
+        db = dB;
+        gain = convert(static_cast<SampleType>(dB));
+    }
+
+    return gain;
+}
+
+// Returns nullptr and sets constantGain when the gain does not move this
+// block, otherwise a per-sample gain ramp. The start is looked up first, so
+// the cache is left holding the end for the next block.
+template <typename SampleType>
+const SampleType* SaturatorDSP<SampleType>::makeGainRamp(const Ramp& gainDb, int numSamples, GainCache& cache,
+                                                         SampleType& constantGain)
+{
+    const auto toGain = [](SampleType dB) { return juce::Decibels::decibelsToGain(dB); };
+
+    if (gainDb.isConstant())
+    {
+        constantGain = cache.get(gainDb.end, toGain);
+        return nullptr;
+    }
+
+    const auto startGain = cache.get(gainDb.start, toGain);
+    constantGain = cache.get(gainDb.end, toGain);
+
+    fillRamp(gainRamp.data(), numSamples, startGain, constantGain);
+    return gainRamp.data();
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::processPreChain(juce::AudioBuffer<SampleType>& buffer, const Ramp& inputTrimDb, Mode mode)
+{
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = buffer.getNumChannels();
+    const auto& target = tables->preEmphasis[static_cast<size_t>(mode)];
+    auto* const* channels = buffer.getArrayOfWritePointers();
+
+    SampleType gain = 1;
+    const SampleType* gains = makeGainRamp(inputTrimDb, numSamples, inputTrimGain, gain);
+
+    // Every group replays the same fade from the block's starting point
+    EmphasisSet coefficients = preEmphasisCurrent;
+
+    auto runGroup = [&](auto sampleType, int first, int groupSize)
+    {
+        using T = decltype(sampleType);
+        const auto f = static_cast<size_t>(first);
+
+        // A single channel is processed in place
+        SampleType* lanes = ValveShaper::getAlignedPointer(scratch[0].lanes.data());
+        T* data = nullptr;
+
+        if constexpr (lanesIn<T> > 1)
+        {
+            interleave(channels + first, groupSize, numSamples, lanesIn<T>, lanes);
+            data = reinterpret_cast<T*>(lanes);
+        }
+        else
+        {
+            data = channels[first];
+        }
+
+        auto registers = gatherChain<T>(&preDCBlocker[f], &preEmphasisState[f], groupSize);
+
+        coefficients = preEmphasisCurrent;
+        int fadePosition = emphasisFadePosition;
+
+        for (int pos = 0; pos < numSamples;)
+        {
+            const int chunk = advanceEmphasisFade(numSamples - pos, fadePosition,
+                                                  coefficients, preEmphasisStart, target);
+
+            runPreChain(data + pos, chunk, gains != nullptr ? gains + pos : nullptr, gain,
+                        preDCBlocker[f].coeff, coefficients, registers);
+            pos += chunk;
+        }
+
+        scatterChain(registers, &preDCBlocker[f], &preEmphasisState[f], groupSize);
+
+        if constexpr (lanesIn<T> > 1)
+            deinterleave(lanes, groupSize, numSamples, lanesIn<T>, channels + first);
+    };
+
+    for (int first = 0; first < numChannels; first += laneCount)
+    {
+        const int groupSize = juce::jmin(laneCount, numChannels - first);
+
+       #if JUCE_USE_SIMD
+        if (groupSize > 1)
+        {
+            runGroup(juce::dsp::SIMDRegister<SampleType>(), first, groupSize);
+            continue;
+        }
+       #endif
+
+        runGroup(SampleType(), first, groupSize);
+    }
+
+    preEmphasisCurrent = coefficients;
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::processPostChain(juce::AudioBuffer<SampleType>& buffer, const Ramp& outputTrimDb, Mode mode)
+{
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = buffer.getNumChannels();
+    const auto& target = tables->postEmphasis[static_cast<size_t>(mode)];
+    auto* const* channels = buffer.getArrayOfWritePointers();
+
+    SampleType gain = 1;
+    const SampleType* gains = makeGainRamp(outputTrimDb, numSamples, outputTrimGain, gain);
+
+    EmphasisSet coefficients = postEmphasisCurrent;
+    int fadePosition = emphasisFadePosition;
+
+    auto runGroup = [&](auto sampleType, int first, int groupSize)
+    {
+        using T = decltype(sampleType);
+        const auto f = static_cast<size_t>(first);
+
+        // A single channel is processed in place
+        SampleType* lanes = ValveShaper::getAlignedPointer(scratch[0].lanes.data());
+        T* data = nullptr;
+
+        if constexpr (lanesIn<T> > 1)
+        {
+            interleave(channels + first, groupSize, numSamples, lanesIn<T>, lanes);
+            data = reinterpret_cast<T*>(lanes);
+        }
+        else
+        {
+            data = channels[first];
+        }
+
+        auto registers = gatherChain<T>(&postDCBlocker[f], &postEmphasisState[f], groupSize);
+
+        coefficients = postEmphasisCurrent;
+        fadePosition = emphasisFadePosition;
+
+        for (int pos = 0; pos < numSamples;)
+        {
+            const int chunk = advanceEmphasisFade(numSamples - pos, fadePosition,
+                                                  coefficients, postEmphasisStart, target);
+
+            runPostChain(data + pos, chunk, gains != nullptr ? gains + pos : nullptr, gain,
+                         postDCBlocker[f].coeff, coefficients, registers);
+            pos += chunk;
+        }
+
+        scatterChain(registers, &postDCBlocker[f], &postEmphasisState[f], groupSize);
+
+        if constexpr (lanesIn<T> > 1)
+            deinterleave(lanes, groupSize, numSamples, lanesIn<T>, channels + first);
+    };
+
+    for (int first = 0; first < numChannels; first += laneCount)
+    {
+        const int groupSize = juce::jmin(laneCount, numChannels - first);
+
+       #if JUCE_USE_SIMD
+        if (groupSize > 1)
+        {
+            runGroup(juce::dsp::SIMDRegister<SampleType>(), first, groupSize);
+            continue;
+        }
+       #endif
+
+        runGroup(SampleType(), first, groupSize);
+    }
+
+    postEmphasisCurrent = coefficients;
+    emphasisFadePosition = fadePosition;
+}
+
+//==============================================================================
+// Valve Stage
+//==============================================================================
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::processValveStage(juce::dsp::AudioBlock<SampleType>& block, Path& path,
+                                                 const BandParameters& params, PolyphaseIIR<SampleType>* polyphase)
+{
+    switch (path.mode)
+    {
+        case Mode::Triode:  processValveStage<Mode::Triode>(block, path, params, polyphase);  break;
+        case Mode::Pentode: processValveStage<Mode::Pentode>(block, path, params, polyphase); break;
+        case Mode::Torture: processValveStage<Mode::Torture>(block, path, params, polyphase); break;
+        default:            jassertfalse; break;
+    }
+}
+
+template <typename SampleType>
+template <SaturatorDSPBase::Mode mode>
+void SaturatorDSP<SampleType>::processValveStage(juce::dsp::AudioBlock<SampleType>& block, Path& path,
+                                                 const BandParameters& params, PolyphaseIIR<SampleType>* polyphase)
+{
+    switch (path.factor)
+    {
+        case 1:  processValveGroups<mode, 1>(block, path, params, polyphase);  break;
+        case 2:  processValveGroups<mode, 2>(block, path, params, polyphase);  break;
+        case 4:  processValveGroups<mode, 4>(block, path, params, polyphase);  break;
+        case 8:  processValveGroups<mode, 8>(block, path, params, polyphase);  break;
+        case 16: processValveGroups<mode, 16>(block, path, params, polyphase); break;
+        default: jassertfalse; break;
+    }
+}
+
+template <typename SampleType>
+template <SaturatorDSPBase::Mode mode, int factor>
+void SaturatorDSP<SampleType>::processValveGroups(juce::dsp::AudioBlock<SampleType>& block, Path& path,
+                                                  const BandParameters& params, PolyphaseIIR<SampleType>* polyphase)
+{
+    using Curve = Voicing<mode>;
+
+    const int numSamples = static_cast<int>(block.getNumSamples());
+    const int numChannels = static_cast<int>(block.getNumChannels());
+    const int osNumSamples = polyphase != nullptr ? numSamples * factor : numSamples;
+    const int hostNumSamples = polyphase != nullptr ? numSamples : numSamples / factor;
+    const int numSegments = (hostNumSamples + sagControlInterval - 1) / sagControlInterval;
+    const bool adaa = usesADAA(path.quality);
+    auto& work = getScratch(path.band);
+
+    std::array<SampleType*, maxChannels> channels {};
+    for (int ch = 0; ch < numChannels; ++ch)
+        channels[static_cast<size_t>(ch)] = block.getChannelPointer(static_cast<size_t>(ch));
+
+    // Drive is converted to linear gain at the block ends only, through the
+    // path's cache, and ramped linearly in between, shared by all channels.
+    // The ramps cover oversampled samples [first, first + length) of the
+    // block.
+    const auto value = [](float v) { return static_cast<SampleType>(v); };
+    const auto toGain = [](SampleType dB) { return std::pow(SampleType(10), dB / SampleType(20)); };
+    const auto driveStart = path.drive.get(params.driveDb.start, toGain);
+    const auto driveEnd = path.drive.get(params.driveDb.end, toGain);
+
+    auto fillRamps = [&](int first, int length)
+    {
+        fillRamp(work.driveRamp.data(), first, length, osNumSamples, driveStart, driveEnd);
+        fillRamp(work.biasRamp.data(), first, length, osNumSamples, value(params.bias.start), value(params.bias.end));
+    };
+
+    // ADAA keeps double precision history per channel, so it runs channel
+    // by channel on deinterleaved data
+    auto runADAA = [&](SampleType* const* groupChannels, size_t first, int groupSize, int length)
+    {
+        for (int ch = 0; ch < groupSize; ++ch)
+        {
+            auto& shaper = path.adaaShaper[first + static_cast<size_t>(ch)];
+            shaper.order = (path.quality == Quality::Live1x) ? 2 : 1;
+            shaper.process(groupChannels[ch], length, Curve::curvature, Curve::asymmetry);
+        }
+    };
+
+    if (polyphase == nullptr)
+        fillRamps(0, numSamples);
+
+    // The group is interleaved (or, for one channel, copied) into aligned
+    // scratch. The sag gains from the host-rate detector are ramped
+    // linearly per lane across each control segment, so drive, bias, sag
+    // and the shaper are all element-wise and run over the whole group.
+    // A polyphase path runs them on each tile its oversampler hands over,
+    // between interpolation and decimation.
+    auto runGroup = [&](auto sampleType, int first, int groupSize)
+    {
+        using T = decltype(sampleType);
+        const auto f = static_cast<size_t>(first);
+        SampleType* const* groupChannels = channels.data() + first;
+
+        SampleType* lanes = ValveShaper::getAlignedPointer(work.lanes.data());
+        interleave(groupChannels, groupSize, numSamples, lanesIn<T>, lanes);
+
+        std::array<T, maxSagSegments + 1> sagGains;
+        for (int j = 0; j <= numSegments; ++j)
+            for (size_t lane = 0; lane < lanesIn<T>; ++lane)
+                setLane(sagGains[static_cast<size_t>(j)], lane,
+                        lane < static_cast<size_t>(groupSize)
+                            ? work.sagGains[(f + lane) * static_cast<size_t>(sagGainStride) + static_cast<size_t>(j)]
+                            : SampleType(1));
+
+        auto* sagRamp = reinterpret_cast<T*>(ValveShaper::getAlignedPointer(work.sagRamp.data()));
+
+        auto shape = [&](T* data, int position, int length)
+        {
+            fillSagRamp(sagRamp, position, length, sagControlInterval * factor, osNumSamples, sagGains.data());
+            runDrive(data, length, sagRamp, work.biasRamp.data(), work.driveRamp.data());
+
+            if (! adaa)
+                ValveShaper::process<Curve>(shaperKernel, reinterpret_cast<SampleType*>(data),
+                                            length * static_cast<int>(lanesIn<T>));
+        };
+
+        if (polyphase == nullptr)
+        {
+            shape(reinterpret_cast<T*>(lanes), 0, numSamples);
+        }
+        else
+        {
+            auto* tiles = reinterpret_cast<T*>(ValveShaper::getAlignedPointer(work.tiles.data()));
+            auto state = gatherPolyphase<T>(*polyphase, first, groupSize);
+
+            polyphase->process(reinterpret_cast<T*>(lanes), reinterpret_cast<T*>(lanes), numSamples, state, tiles,
+                               [&](T* tile, int position, int length)
+            {
+                fillRamps(position, length);
+                shape(tile, position, length);
+
+                if (! adaa)
+                    return;
+
+                auto* tileData = reinterpret_cast<SampleType*>(tile);
+
+                if constexpr (lanesIn<T> > 1)
+                {
+                    std::array<SampleType*, lanesIn<T>> tileChannels {};
+                    for (size_t ch = 0; ch < lanesIn<T>; ++ch)
+                        tileChannels[ch] = work.tileChannels.data() + ch * static_cast<size_t>(PolyphaseIIR<SampleType>::tileLength);
+
+                    deinterleave(tileData, groupSize, length, lanesIn<T>, tileChannels.data());
+                    runADAA(tileChannels.data(), f, groupSize, length);
+                    interleave(tileChannels.data(), groupSize, length, lanesIn<T>, tileData);
+                }
+                else
+                {
+                    runADAA(&tileData, f, groupSize, length);
+                }
+            });
+
+            scatterPolyphase<T>(state, *polyphase, first, groupSize);
+        }
+
+        deinterleave(lanes, groupSize, numSamples, lanesIn<T>, groupChannels);
+
+        if (adaa && polyphase == nullptr)
+            runADAA(groupChannels, f, groupSize, numSamples);
+    };
+
+    for (int first = 0; first < numChannels; first += laneCount)
+    {
+        const int groupSize = juce::jmin(laneCount, numChannels - first);
+
+       #if JUCE_USE_SIMD
+        if (groupSize > 1)
+        {
+            runGroup(juce::dsp::SIMDRegister<SampleType>(), first, groupSize);
+            continue;
+        }
+       #endif
+
+        runGroup(SampleType(), first, groupSize);
+    }
+}
+
+//==============================================================================
+// Tail and Idle Detection
+//==============================================================================
+
+template <typename SampleType>
+int SaturatorDSP<SampleType>::computeTailSamples() const
+{
+    constexpr double ringOut = 1.0e-6;      // -120 dB
+    constexpr double sagSettled = 1.0e-3;   // drive within 0.01 dB of unsagged
+
+    const float latency = getMaxBuiltLatency();
+
+    // The stages are in series, so their ring-out times add up. Each EQ
+    // side takes its slowest mode.
+    const double dcDecay = std::log(ringOut) / std::log(static_cast<double>(preDCBlocker.front().coeff));
+    double preDecay = 0.0, postDecay = 0.0;
+
+    for (size_t m = 0; m < static_cast<size_t>(numModes); ++m)
+    {
+        double pre = 0.0, post = 0.0;
+        for (size_t k = 0; k < 3; ++k)
+        {
+            pre += biquadDecaySamples(tables->preEmphasis[m][k], ringOut);
+            post += biquadDecaySamples(tables->postEmphasis[m][k], ringOut);
+        }
+
+        preDecay = juce::jmax(preDecay, pre);
+        postDecay = juce::jmax(postDecay, post);
+    }
+
+    const double ringOutSamples = static_cast<double>(std::ceil(latency)) + 2.0 * dcDecay + preDecay + postDecay;
+
+    // 200 ms release time constant
+    const double sagSamples = -std::log(sagSettled) * 0.200 * currentSampleRate;
+
+    return static_cast<int>(std::ceil(juce::jmax(ringOutSamples, sagSamples)));
+}
+
+template <typename SampleType>
+double SaturatorDSP<SampleType>::getTailLengthSeconds() const
+{
+    return static_cast<double>(tailSamples) / currentSampleRate;
+}
+
+// Returns true once every channel has been silent for longer than the tail
+template <typename SampleType>
+bool SaturatorDSP<SampleType>::updateSilence(const juce::AudioBuffer<SampleType>& buffer)
+{
+    const int numSamples = buffer.getNumSamples();
+    bool allSilent = true;
+
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+    {
+        auto& count = silentSamples[static_cast<size_t>(ch)];
+
+        if (buffer.getMagnitude(ch, 0, numSamples) < silenceThreshold)
+        {
+            count = juce::jmin(count + numSamples, tailSamples + 1);
+        }
+        else
+        {
+            const auto* data = buffer.getReadPointer(ch);
+            int lastLoud = numSamples - 1;
+            while (std::abs(data[lastLoud]) < silenceThreshold)
+                --lastLoud;
+
+            count = numSamples - 1 - lastLoud;
+        }
+
+        allSilent = allSilent && count > tailSamples;
+    }
+
+    return allSilent;
+}
+
+//==============================================================================
+// Metering
+//==============================================================================
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::publishLevels(const juce::AudioBuffer<SampleType>& buffer,
+                                             std::atomic<float>& peak,
+                                             std::atomic<float>& rms,
+                                             double& meanSquare)
+{
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = buffer.getNumChannels();
+
+    if (numSamples == 0 || numChannels == 0)
+        return;
+
+    SampleType blockPeak = 0;
+    double sumSquares = 0.0;
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        blockPeak = juce::jmax(blockPeak, buffer.getMagnitude(ch, 0, numSamples));
+
+        const auto level = static_cast<double>(buffer.getRMSLevel(ch, 0, numSamples));
+        sumSquares += level * level;
+    }
+
+    // Mean power across channels through a one-pole over the RMS window
+    const double blockMeanSquare = sumSquares / numChannels;
+    if (numSamples != rmsDecaySamples)
+    {
+        rmsDecaySamples = numSamples;
+        rmsDecay = std::exp(-numSamples / (rmsWindowSeconds * currentSampleRate));
+    }
+
+    meanSquare = blockMeanSquare + rmsDecay * (meanSquare - blockMeanSquare);
+    rms.store(static_cast<float>(std::sqrt(meanSquare)), std::memory_order_relaxed);
+
+    // A reader may clear the held peak at any time, so raise it with a
+    // compare-exchange instead of a plain store
+    const auto newPeak = static_cast<float>(blockPeak);
+    auto held = peak.load(std::memory_order_relaxed);
+
+    while (newPeak > held && ! peak.compare_exchange_weak(held, newPeak, std::memory_order_relaxed))
+    {
+    }
+}
+
+// Sag gain reduction from the active paths' envelopes as they stand at the
+// end of the block, for the most compressed channel of any band that is on,
+// floored at -60 dB
+template <typename SampleType>
+float SaturatorDSP<SampleType>::getSagReductionDb(const Parameters& params) const
+{
+    SampleType gain = 1;
+
+    for (int b = 0; b < activeBands; ++b)
+    {
+        const auto& band = bands[static_cast<size_t>(b)];
+        if (band.bypassed)
+            continue;
+
+        const float sagAmount = activeBands == 1 ? params.sagAmount.end
+                                                 : params.bands[static_cast<size_t>(b)].sagAmount.end;
+
+        for (const auto& env : band.paths[static_cast<size_t>(band.activePath)].sagEnvelope)
+            gain = juce::jmin(gain, SampleType(1) - static_cast<SampleType>(sagAmount) * env.envelope);
+    }
+
+    return -static_cast<float>(juce::Decibels::gainToDecibels(juce::jmax(SampleType(1.0e-3), gain)));
+}
+
+//==============================================================================
+// Oversampled Paths
+//==============================================================================
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::configurePath(Path& path, Mode mode, QualitySetting quality)
+{
+    path.factor = getBandFactor(mode, quality.quality, path.band, activeBands);
+    path.mode = mode;
+    path.quality = quality.quality;
+    path.filter = quality.filter;
+
+    for (auto& adaa : path.adaaShaper)
+        adaa.reset();
+
+    std::fill(path.fractionalPad.begin(), path.fractionalPad.end(), typename Path::FractionalPad {});
+
+    path.latencyPadSamples = getAlignedPathLatency(quality) - getPathLatency(path.factor, path.filter);
+    jassert(path.latencyPadSamples >= 0 && path.latencyPadSamples <= maxLatencyPad);
+
+    path.latencyPad.reset();
+    path.latencyPad.setDelay(static_cast<SampleType>(path.latencyPadSamples));
+}
+
+// Runs the band's recent input through a freshly configured path so its
+// filters hold the same signal the band has seen. Only the output is
+// thrown away.
+template <typename SampleType>
+void SaturatorDSP<SampleType>::primePath(Band& band, Path& path, const BandParameters& params)
+{
+    if (path.filter == Filter::PolyphaseIIR)
+    {
+        if (auto* oversampler = getPolyphaseOversampler(path.band, path.factor))
+            oversampler->reset();
+    }
+    else if (auto* oversampler = getHalfBandOversampler(path.band, path.factor))
+    {
+        oversampler->reset();
+    }
+
+    BandParameters primeParams;
+    primeParams.driveDb = params.driveDb.start;
+    primeParams.bias = params.bias.start;
+    primeParams.sagAmount = params.sagAmount.start;
+
+    auto& transition = getScratch(path.band).transition;
+
+    for (int pos = 0; pos < band.primeHistoryLength;)
+    {
+        const int chunk = juce::jmin(currentBlockSize, band.primeHistoryLength - pos);
+        transition.setSize(currentNumChannels, chunk, false, false, true);
+
+        for (int ch = 0; ch < currentNumChannels; ++ch)
+            transition.copyFrom(ch, 0, band.primeHistory, ch, pos, chunk);
 
-void SaturatorDSP::DCBlocker::reset()
-{
-    x1 = 0.0f;
-    y1 = 0.0f;
+        runPath(path, transition, primeParams);
+        pos += chunk;
+    }
 }
 
-float SaturatorDSP::DCBlocker::process(float x)
+template <typename SampleType>
+void SaturatorDSP<SampleType>::startTransition(Band& band, Mode mode, QualitySetting quality, const BandParameters& params)
 {
-    // y[n] = x[n] - x[n-1] + R * y[n-1]
-    float y = x - x1 + coeff * y1;
-    x1 = x;
-    y1 = y;
-    return y;
-}
+    const auto& from = band.paths[static_cast<size_t>(band.activePath)];
+    auto& to = band.paths[static_cast<size_t>(1 - band.activePath)];
 
-//==============================================================================
-// Envelope Follower for Sag
-//==============================================================================
+    configurePath(to, mode, quality);
+    primePath(band, to, params);
 
-void SaturatorDSP::EnvelopeFollower::prepare(double sampleRate)
-{
-    attackCoeff = static_cast<float>(1.0 - std::exp(-1.0 / (sampleRate * 0.008)));
-    releaseCoeff = static_cast<float>(1.0 - std::exp(-1.0 / (sampleRate * 0.200)));
-    reset();
+    // The envelope runs at the host rate in every path, so it carries over
+    // as is
+    to.sagEnvelope = from.sagEnvelope;
+
+    band.activePath = 1 - band.activePath;
+    band.transitionPosition = 0;
 }
 
-void SaturatorDSP::EnvelopeFollower::reset()
+// Keeps the last primeLength pre-chain samples, oldest first
+template <typename SampleType>
+void SaturatorDSP<SampleType>::pushPrimeHistory(Band& band, const juce::AudioBuffer<SampleType>& buffer)
 {
-    envelope = 0.0f;
+    auto& primeHistory = band.primeHistory;
+    auto& primeHistoryLength = band.primeHistoryLength;
+
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = juce::jmin(buffer.getNumChannels(), primeHistory.getNumChannels());
+
+    if (numSamples >= primeLength)
+    {
+        for (int ch = 0; ch < numChannels; ++ch)
+            primeHistory.copyFrom(ch, 0, buffer, ch, numSamples - primeLength, primeLength);
+
+        primeHistoryLength = primeLength;
+        return;
+    }
+
+    const int keep = juce::jmin(primeHistoryLength, primeLength - numSamples);
+
+    for (int ch = 0; ch < numChannels; ++ch)
+    {
+        auto* history = primeHistory.getWritePointer(ch);
+        std::copy(history + primeHistoryLength - keep, history + primeHistoryLength, history);
+        juce::FloatVectorOperations::copy(history + keep, buffer.getReadPointer(ch), numSamples);
+    }
+
+    primeHistoryLength = keep + numSamples;
 }
 
-float SaturatorDSP::EnvelopeFollower::process(float input)
+template <typename SampleType>
+void SaturatorDSP<SampleType>::runPath(Path& path, juce::AudioBuffer<SampleType>& buffer, const BandParameters& params)
 {
-    float rectified = std::abs(input);
-    float c = (rectified > envelope) ? attackCoeff : releaseCoeff;
-    envelope += c * (rectified - envelope);
-    return envelope;
+    // --- 4. Oversampling (up) ---
+    // A polyphase IIR path up- and downsamples inside the valve stage, so
+    // its oversampled signal is never held for more than a tile
+    auto* polyphase = path.filter == Filter::PolyphaseIIR ? getPolyphaseOversampler(path.band, path.factor) : nullptr;
+    auto* halfBand = path.filter == Filter::HalfBandFIR ? getHalfBandOversampler(path.band, path.factor) : nullptr;
+
+    juce::dsp::AudioBlock<SampleType> inputBlock(buffer);
+    auto block = halfBand != nullptr ? halfBand->processSamplesUp(inputBlock) : inputBlock;
+    SATURATOR_STAGE_LAP(Upsample)
+
+    // --- 7. Sag detector (at the host rate) ---
+    // Follows the host-rate input, which upsampling leaves untouched. The
+    // valve stage ramps the gains it leaves per control segment.
+    runSagDetector(path, buffer, params.sagAmount);
+
+    // --- 5 + 6 + 7. Drive, Valve Shaper, and Sag gain (at oversampled rate) ---
+    processValveStage(block, path, params, polyphase);
+    SATURATOR_STAGE_LAP(ValveStage)
+
+    // --- 8. Downsample, padded to the quality's common latency ---
+    if (halfBand != nullptr)
+        halfBand->processSamplesDown(inputBlock);
+
+    if (path.latencyPadSamples > 0)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto* data = buffer.getWritePointer(ch);
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                path.latencyPad.pushSample(ch, data[i]);
+                data[i] = path.latencyPad.popSample(ch);
+            }
+        }
+    }
+
+    // Live 2x up to a whole sample: y[n] = x[n - 1] + alpha (x[n] - y[n - 1])
+    if (path.quality == Quality::Live2x)
+    {
+        constexpr auto d = static_cast<SampleType>(live2xPadDelay);
+        constexpr auto alpha = (SampleType(1) - d) / (SampleType(1) + d);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto& pad = path.fractionalPad[static_cast<size_t>(ch)];
+            auto* data = buffer.getWritePointer(ch);
+            SampleType x1 = pad.x1, y1 = pad.y1;
+
+            for (int i = 0; i < buffer.getNumSamples(); ++i)
+            {
+                const SampleType x = data[i];
+                y1 = x1 + (x - y1) * alpha;
+                x1 = x;
+                data[i] = y1;
+            }
+
+            pad.x1 = x1;
+            pad.y1 = snapToZero(y1);
+        }
+    }
+    SATURATOR_STAGE_LAP(Downsample)
 }
 
 //==============================================================================
-// Valve Shaper
+// Bands
 //==============================================================================
 
-SaturatorDSP::ValveParams SaturatorDSP::getValveParams(Mode mode)
+// Linkwitz-Riley split of the pre-chain output into bandBuffers. With three
+// bands the low band goes through an allpass at the upper crossover, so it
+// lines up in phase with the mid and high bands and the sum stays flat.
+template <typename SampleType>
+void SaturatorDSP<SampleType>::splitBands(const juce::AudioBuffer<SampleType>& buffer, const Parameters& params)
 {
-    switch (mode)
+    const auto nyquistLimit = static_cast<SampleType>(0.45 * currentSampleRate);
+    const auto lowCutoff = juce::jlimit(SampleType(20), nyquistLimit, static_cast<SampleType>(params.lowCrossoverHz));
+    const auto highCutoff = juce::jlimit(lowCutoff, nyquistLimit, static_cast<SampleType>(params.highCrossoverHz));
+
+    if (! juce::approximatelyEqual(lowSplit.getCutoffFrequency(), lowCutoff))
+        lowSplit.setCutoffFrequency(lowCutoff);
+
+    if (! juce::approximatelyEqual(highSplit.getCutoffFrequency(), highCutoff))
+    {
+        highSplit.setCutoffFrequency(highCutoff);
+        lowAllpass.setCutoffFrequency(highCutoff);
+    }
+
+    const int numSamples = buffer.getNumSamples();
+    const int numChannels = buffer.getNumChannels();
+
+    for (int b = 0; b < activeBands; ++b)
+        bandBuffers[static_cast<size_t>(b)].setSize(numChannels, numSamples, false, false, true);
+
+    for (int ch = 0; ch < numChannels; ++ch)
     {
-        case Mode::Triode:  return { 2.5f, 0.5f };
-        case Mode::Pentode: return { 4.0f, 0.85f };
-        case Mode::Torture: return { 8.0f, 0.7f };
-        default:            return { 4.0f, 0.5f };
+        const auto* input = buffer.getReadPointer(ch);
+        auto* low = bandBuffers[0].getWritePointer(ch);
+        auto* high = bandBuffers[1].getWritePointer(ch);
+
+        if (activeBands == 2)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                lowSplit.processSample(ch, input[i], low[i], high[i]);
+
+            continue;
+        }
+
+        auto* mid = bandBuffers[1].getWritePointer(ch);
+        high = bandBuffers[2].getWritePointer(ch);
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            SampleType lowBand, upperBand;
+            lowSplit.processSample(ch, input[i], lowBand, upperBand);
+            highSplit.processSample(ch, upperBand, mid[i], high[i]);
+            low[i] = lowAllpass.processSample(ch, lowBand);
+        }
     }
 }
 
-float SaturatorDSP::valveShaper(float x, float a, float b)
+// Runs one band through its oversampled path in place. In the multiband
+// modes a band at 0 dB drive is bypassed: it fades over to its clean,
+// latency-matched input at the drive it had, then stops running its path.
+// Turning it back on primes the path with the band's recent input and
+// fades it in.
+template <typename SampleType>
+void SaturatorDSP<SampleType>::processBand(int index,
+                                           juce::AudioBuffer<SampleType>& buffer,
+                                           const BandParameters& params,
+                                           Mode mode,
+                                           QualitySetting quality)
 {
-    float xp = x * (1.0f + b);
-    float xn = x * (1.0f - b);
+    auto& band = bands[static_cast<size_t>(index)];
+    auto& cleanDelay = cleanDelays[static_cast<size_t>(index)];
+    const int numSamples = buffer.getNumSamples();
+    const bool bypassable = activeBands > 1;
 
-    return (x >= 0.0f)
-        ? std::tanh(a * xp)
-        : std::tanh(a * xn);
-}
+    // --- Band bypass ---
+    if (bypassable)
+    {
+        const bool off = params.driveDb.start <= 0.0f && params.driveDb.end <= 0.0f;
 
-//==============================================================================
-// EQ Configuration
-//==============================================================================
+        if (off != band.bypassed)
+        {
+            const bool pathStopped = band.bypassFadePosition >= transitionLength;
+            band.bypassed = off;
 
-void SaturatorDSP::updatePreEmphasis(double sampleRate, Mode mode)
-{
-    float hpfFreq = 60.0f;
-    float midFreq = 1000.0f;
-    float midGainDb = 6.0f;
-    float midQ = 0.6f;
-    float hfShelfFreq = 6000.0f;
-    float hfShelfGainDb = 3.0f;
+            if (! off && (pathStopped || ! band.pathsConfigured))
+            {
+                auto& current = band.paths[static_cast<size_t>(band.activePath)];
+                configurePath(current, mode, quality);
+                primePath(band, current, params);
+                band.pathsConfigured = true;
+                band.transitionPosition = transitionLength;
+            }
 
-    switch (mode)
+            // A fade in progress turns around from where it is
+            if (off && ! band.pathsConfigured)
+                band.bypassFadePosition = transitionLength;
+            else
+                band.bypassFadePosition = transitionLength - juce::jmin(band.bypassFadePosition, transitionLength);
+        }
+
+        // The clean signal is read only while bypassed or fading. A running
+        // band keeps just the history a fade starting next block reads.
+        const bool cleanRead = band.bypassed || band.bypassFadePosition < transitionLength;
+        cleanDelay.setDelay(juce::roundToInt(getLatencyInSamples(quality)));
+        cleanDelay.push(buffer, ! cleanRead);
+
+        if (band.bypassed && band.bypassFadePosition >= transitionLength)
+        {
+            pushPrimeHistory(band, buffer);
+
+            for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+            {
+                buffer.clear(ch, 0, numSamples);
+                cleanDelay.addDelayed(ch, buffer.getWritePointer(ch), numSamples, SampleType(1));
+            }
+
+            return;
+        }
+    }
+
+    // A band fading out keeps the settings it had when it was turned off
+    if (! band.bypassed)
+        band.heldParameters = { params.driveDb.end, params.bias.end, params.sagAmount.end };
+
+    const auto& pathParams = band.bypassed ? band.heldParameters : params;
+
+    // --- Path selection ---
+    // A new oversampling factor or filter fades over to the band's other
+    // path. A change that arrives mid-fade drops the outgoing path and
+    // starts again from the current one. Two paths with the same factor and
+    // filter would share an oversampler, so a quality change that keeps
+    // both switches in place.
+    auto& current = band.paths[static_cast<size_t>(band.activePath)];
+
+    if (! band.pathsConfigured)
     {
-        case Mode::Triode:
-            midGainDb = 4.0f;
-            hfShelfGainDb = 2.0f;
-            break;
-        case Mode::Pentode:
-            midGainDb = 8.0f;
-            hfShelfGainDb = 3.0f;
-            break;
-        case Mode::Torture:
-            midGainDb = 6.0f;
-            hfShelfGainDb = 4.0f;
-            break;
+        configurePath(current, mode, quality);
+        band.pathsConfigured = true;
+    }
+    else if (getBandFactor(mode, quality.quality, index, activeBands) != current.factor
+             || quality.filter != current.filter)
+    {
+        band.transitionPosition = transitionLength;
+        startTransition(band, mode, quality, pathParams);
+    }
+    else if (quality.quality != current.quality)
+    {
+        configurePath(current, mode, quality);
+    }
+    else
+    {
+        current.mode = mode;
+    }
+
+    const bool fading = band.transitionPosition < transitionLength;
+    auto& transition = getScratch(index).transition;
+
+    if (fading)
+    {
+        transition.setSize(buffer.getNumChannels(), numSamples, false, false, true);
+        transition.makeCopyOf(buffer, true);
+    }
+
+    pushPrimeHistory(band, buffer);
+
+    // --- 4 - 8. Oversampled path(s) ---
+    if (fading)
+        runPath(band.paths[static_cast<size_t>(1 - band.activePath)], transition, pathParams);
+
+    runPath(band.paths[static_cast<size_t>(band.activePath)], buffer, pathParams);
+
+    if (fading)
+    {
+        // Both paths have the same delay, so a linear fade is phase-coherent
+        const SampleType step = SampleType(1) / static_cast<SampleType>(transitionLength);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto* data = buffer.getWritePointer(ch);
+            const auto* old = transition.getReadPointer(ch);
+
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const SampleType g = juce::jmin(SampleType(1), static_cast<SampleType>(band.transitionPosition + i + 1) * step);
+                data[i] = old[i] + g * (data[i] - old[i]);
+            }
+        }
+
+        band.transitionPosition = juce::jmin(transitionLength, band.transitionPosition + numSamples);
+        SATURATOR_STAGE_LAP(Downsample)
     }
 
-    *preHPF.state = *juce::dsp::IIR::Coefficients<float>::makeHighPass(
-        sampleRate, hpfFreq, 0.5f);
+    // --- Bypass fade ---
+    // The clean signal is read into the transition buffer, free again once
+    // any path crossfade above is done
+    if (bypassable && band.bypassFadePosition < transitionLength)
+    {
+        const SampleType step = SampleType(1) / static_cast<SampleType>(transitionLength);
+        transition.setSize(buffer.getNumChannels(), numSamples, false, false, true);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto* data = buffer.getWritePointer(ch);
+            auto* clean = transition.getWritePointer(ch);
+
+            juce::FloatVectorOperations::clear(clean, numSamples);
+            cleanDelay.addDelayed(ch, clean, numSamples, SampleType(1));
 
-    *preMidBoost.state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-        sampleRate, midFreq, midQ,
-        juce::Decibels::decibelsToGain(midGainDb));
+            for (int i = 0; i < numSamples; ++i)
+            {
+                const SampleType g = juce::jmin(SampleType(1), static_cast<SampleType>(band.bypassFadePosition + i + 1) * step);
+                const SampleType wet = band.bypassed ? SampleType(1) - g : g;
+                data[i] = clean[i] + wet * (data[i] - clean[i]);
+            }
+        }
 
-    *preHFShelf.state = *juce::dsp::IIR::Coefficients<float>::makeHighShelf(
-        sampleRate, hfShelfFreq, 0.7f,
-        juce::Decibels::decibelsToGain(hfShelfGainDb));
+        band.bypassFadePosition = juce::jmin(transitionLength, band.bypassFadePosition + numSamples);
+    }
 }
 
-void SaturatorDSP::updatePostEmphasis(double sampleRate, Mode mode)
+// Allocates the state of bands up to numBands that are not prepared yet.
+// The split buffers and clean delays are only needed with more than one
+// band, so the full-band chain never allocates them.
+template <typename SampleType>
+void SaturatorDSP<SampleType>::prepareBands(int numBands)
 {
-    float lpfFreq = 12000.0f;
-    float lowShelfFreq = 120.0f;
-    float lowShelfGainDb = 3.0f;
-    float presenceDipFreq = 3000.0f;
-    float presenceDipDb = -3.0f;
+    juce::dsp::ProcessSpec spec;
+    spec.sampleRate = currentSampleRate;
+    spec.maximumBlockSize = static_cast<juce::uint32>(currentBlockSize);
+    spec.numChannels = static_cast<juce::uint32>(currentNumChannels);
 
-    switch (mode)
+    const auto channelCount = static_cast<size_t>(currentNumChannels);
+
+    for (int b = preparedBands; b < numBands; ++b)
     {
-        case Mode::Triode:
-            lpfFreq = 14000.0f;
-            presenceDipDb = -2.0f;
-            lowShelfGainDb = 2.0f;
-            break;
-        case Mode::Pentode:
-            lpfFreq = 11000.0f;
-            presenceDipDb = -4.0f;
-            lowShelfGainDb = 3.5f;
-            break;
-        case Mode::Torture:
-            lpfFreq = 8000.0f;
-            presenceDipDb = -6.0f;
-            lowShelfGainDb = 4.0f;
-            break;
+        auto& band = bands[static_cast<size_t>(b)];
+
+        for (auto& path : band.paths)
+        {
+            path.band = b;
+            path.sagEnvelope.resize(channelCount);
+            path.adaaShaper.resize(channelCount);
+            path.fractionalPad.assign(channelCount, {});
+
+            for (auto& env : path.sagEnvelope) env.prepare(currentSampleRate);
+            for (auto& adaa : path.adaaShaper) adaa.reset();
+
+            path.latencyPad.prepare(spec);
+        }
+
+        band.primeHistory.setSize(currentNumChannels, primeLength);
+        band.primeHistory.clear();
+    }
+
+    if (numBands > 1)
+    {
+        for (int b = preparedBands > 1 ? preparedBands : 0; b < numBands; ++b)
+        {
+            bandBuffers[static_cast<size_t>(b)].setSize(currentNumChannels, currentBlockSize);
+            cleanDelays[static_cast<size_t>(b)].prepare(currentNumChannels, currentBlockSize, dryDelayCapacity);
+        }
+    }
+
+    const bool newBands = numBands > preparedBands;
+    preparedBands = juce::jmax(preparedBands, numBands);
+
+    // Worker threads give every band its own scratch
+    if (newBands && workerPool != nullptr && scratchFactor > 0)
+        resizeScratch(scratchFactor);
+}
+
+// Clears every band's paths, transitions and bypass state along with the
+// crossovers. The next block configures each band's path directly.
+template <typename SampleType>
+void SaturatorDSP<SampleType>::resetBands()
+{
+    for (auto& band : bands)
+    {
+        for (auto& path : band.paths)
+        {
+            for (auto& env : path.sagEnvelope) env.reset();
+            for (auto& adaa : path.adaaShaper) adaa.reset();
+            std::fill(path.fractionalPad.begin(), path.fractionalPad.end(), typename Path::FractionalPad {});
+            path.latencyPad.reset();
+        }
+
+        band.pathsConfigured = false;
+        band.transitionPosition = transitionLength;
+        band.primeHistoryLength = 0;
+        band.bypassed = false;
+        band.bypassFadePosition = transitionLength;
     }
 
-    *postLPF.state = *juce::dsp::IIR::Coefficients<float>::makeLowPass(
-        sampleRate, lpfFreq, 0.7f);
+    for (auto& cleanDelay : cleanDelays)
+        cleanDelay.reset();
 
-    *postLowShelf.state = *juce::dsp::IIR::Coefficients<float>::makeLowShelf(
-        sampleRate, lowShelfFreq, 0.7f,
-        juce::Decibels::decibelsToGain(lowShelfGainDb));
+    lowSplit.reset();
+    highSplit.reset();
+    lowAllpass.reset();
 
-    *postPresenceDip.state = *juce::dsp::IIR::Coefficients<float>::makePeakFilter(
-        sampleRate, presenceDipFreq, 1.0f,
-        juce::Decibels::decibelsToGain(presenceDipDb));
+    for (auto& oversampler : polyphaseOversamplers)
+        if (oversampler != nullptr)
+            oversampler->reset();
+
+    for (auto& oversampler : halfBandOversamplers)
+        if (oversampler != nullptr)
+            oversampler->reset();
 }
 
 //==============================================================================
 // SaturatorDSP Main Implementation
 //==============================================================================
 
-SaturatorDSP::SaturatorDSP() {}
+template <typename SampleType>
+SaturatorDSP<SampleType>::SaturatorDSP() {}
 
-void SaturatorDSP::prepare(double sampleRate, int samplesPerBlock, int numChannels)
+template <typename SampleType>
+void SaturatorDSP<SampleType>::prepare(double sampleRate, int samplesPerBlock, int numChannels)
 {
     currentSampleRate = sampleRate;
-    currentBlockSize = samplesPerBlock;
     currentNumChannels = numChannels;
+    rmsDecaySamples = 0;
 
-    for (auto& dc : preDCBlocker)  dc.prepare(sampleRate);
-    for (auto& dc : postDCBlocker) dc.prepare(sampleRate);
-
-    for (auto& env : sagEnvelope) env.prepare(sampleRate);
+    // Everything below is sized for one sub-block, whatever the host block
+    currentBlockSize = juce::jlimit(1, subBlockSize, samplesPerBlock);
 
-    oversampling4x = std::make_unique<juce::dsp::Oversampling<float>>(
-        static_cast<size_t>(numChannels), 2,
-        juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, true);
+    jassert(numChannels > 0 && numChannels <= maxChannels);
 
-    oversampling8x = std::make_unique<juce::dsp::Oversampling<float>>(
-        static_cast<size_t>(numChannels), 3,
-        juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR, true);
+    const auto channelCount = static_cast<size_t>(numChannels);
+    preDCBlocker.resize(channelCount);
+    postDCBlocker.resize(channelCount);
+    preEmphasisState.resize(channelCount);
+    postEmphasisState.resize(channelCount);
 
-    oversampling4x->initProcessing(static_cast<size_t>(samplesPerBlock));
-    oversampling8x->initProcessing(static_cast<size_t>(samplesPerBlock));
+    for (auto& dc : preDCBlocker)  dc.prepare(sampleRate);
+    for (auto& dc : postDCBlocker) dc.prepare(sampleRate);
 
     juce::dsp::ProcessSpec spec;
     spec.sampleRate = sampleRate;
-    spec.maximumBlockSize = static_cast<juce::uint32>(samplesPerBlock);
+    spec.maximumBlockSize = static_cast<juce::uint32>(currentBlockSize);
     spec.numChannels = static_cast<juce::uint32>(numChannels);
 
-    preHPF.prepare(spec);
-    preMidBoost.prepare(spec);
-    preHFShelf.prepare(spec);
+    lowSplit.prepare(spec);
+    highSplit.prepare(spec);
+    lowAllpass.prepare(spec);
+    lowAllpass.setType(juce::dsp::LinkwitzRileyFilterType::allpass);
+
+    tables = getSharedTables(sampleRate);
+
+    // Oversamplers are built for the qualities in use only
+    for (auto& oversampler : polyphaseOversamplers) oversampler.reset();
+    for (auto& oversampler : halfBandOversamplers)  oversampler.reset();
+
+    prepared = true;
+    buildQualitiesInUse();
+
+    preEmphasisCurrent = tables->preEmphasis[static_cast<size_t>(emphasisMode)];
+    postEmphasisCurrent = tables->postEmphasis[static_cast<size_t>(emphasisMode)];
+    std::fill(preEmphasisState.begin(), preEmphasisState.end(), CascadeState {});
+    std::fill(postEmphasisState.begin(), postEmphasisState.end(), CascadeState {});
+
+    emphasisFadeLength = juce::jmax(1, static_cast<int>(sampleRate * 0.005));
+    emphasisFadePosition = emphasisFadeLength;
+
+    dryBuffer.setSize(numChannels, currentBlockSize);
+
+    dryDelayCapacity = static_cast<int>(std::ceil(getMaxBuiltLatency()));
+    dryDelay.prepare(numChannels, currentBlockSize, dryDelayCapacity);
+
+    workerPool = threadCount > 1 ? WorkerPool::getShared() : nullptr;
+
+    // Band 0 is the full-band chain; split bands only when a multiband
+    // count is in use. Scratch is sized once the bands are known.
+    preparedBands = 0;
+    scratchFactor = 0;
+    prepareBands(bandsInUse);
+
+    wetChainIdle = false;
+
+    tailSamples = computeTailSamples();
+    silentSamples.assign(channelCount, 0);
+    idle = false;
+
+    inputMeanSquare = 0.0;
+    outputMeanSquare = 0.0;
+
+    transitionLength = juce::jmax(1, static_cast<int>(sampleRate * 0.02));
+
+    for (auto& band : bands)
+    {
+        band.activePath = 0;
+        band.pathsConfigured = false;
+        band.transitionPosition = transitionLength;
+        band.primeHistoryLength = 0;
+        band.bypassed = false;
+        band.bypassFadePosition = transitionLength;
+    }
+
+    activeBands = 1;
+
+    gainRamp.assign(static_cast<size_t>(currentBlockSize), SampleType(0));
+    resizeScratch(getMaxBlockFactor());
+}
 
-    postLPF.prepare(spec);
-    postLowShelf.prepare(spec);
-    postPresenceDip.prepare(spec);
+template <typename SampleType>
+void SaturatorDSP<SampleType>::reset()
+{
+    resetWetChain();
+    dryDelay.reset();
 
-    updatePreEmphasis(sampleRate, Mode::Triode);
-    updatePostEmphasis(sampleRate, Mode::Triode);
+    std::fill(silentSamples.begin(), silentSamples.end(), 0);
+    idle = false;
 
-    dryBuffer.setSize(numChannels, samplesPerBlock);
+    inputMeanSquare = 0.0;
+    outputMeanSquare = 0.0;
 }
 
-void SaturatorDSP::reset()
+// Clears everything between the dry tap and the mix
+template <typename SampleType>
+void SaturatorDSP<SampleType>::resetWetChain()
 {
     for (auto& dc : preDCBlocker)  dc.reset();
     for (auto& dc : postDCBlocker) dc.reset();
-    for (auto& env : sagEnvelope)  env.reset();
 
-    preHPF.reset();
-    preMidBoost.reset();
-    preHFShelf.reset();
-    postLPF.reset();
-    postLowShelf.reset();
-    postPresenceDip.reset();
+    // The next block configures its paths directly, without a fade
+    resetBands();
 
-    if (oversampling4x) oversampling4x->reset();
-    if (oversampling8x) oversampling8x->reset();
+    std::fill(preEmphasisState.begin(), preEmphasisState.end(), CascadeState {});
+    std::fill(postEmphasisState.begin(), postEmphasisState.end(), CascadeState {});
+
+    // Land any running emphasis fade
+    preEmphasisCurrent = tables->preEmphasis[static_cast<size_t>(emphasisMode)];
+    postEmphasisCurrent = tables->postEmphasis[static_cast<size_t>(emphasisMode)];
+    emphasisFadePosition = emphasisFadeLength;
 }
 
-float SaturatorDSP::getLatencyInSamples(Mode mode) const
+template <typename SampleType>
+float SaturatorDSP<SampleType>::getLatencyInSamples(QualitySetting quality) const
 {
-    if (mode == Mode::Torture && oversampling8x)
-        return oversampling8x->getLatencyInSamples();
-    if (oversampling4x)
-        return oversampling4x->getLatencyInSamples();
-    return 0.0f;
+    auto latency = static_cast<float>(getAlignedPathLatency(quality));
+
+    // ADAA delays by half a sample (first order) or one sample (second
+    // order) at the rate it runs at. Live 2x is padded to a whole sample.
+    if (quality.quality == Quality::Live2x)
+        latency += 0.5f / 2.0f + live2xPadDelay;
+    else if (quality.quality == Quality::Live1x)
+        latency += 1.0f;
+
+    return latency;
 }
 
-void SaturatorDSP::process(juce::AudioBuffer<float>& buffer,
-                            float inputTrimDb,
-                            float driveDb,
-                            float bias,
-                            float sagAmount,
-                            float outputTrimDb,
-                            float mix,
-                            Mode mode)
+template <typename SampleType>
+void SaturatorDSP<SampleType>::applyMix(juce::AudioBuffer<SampleType>& buffer, const Ramp& mix)
 {
+    if (mix.start >= 1.0f && mix.end >= 1.0f)
+        return;
+
     const int numSamples = buffer.getNumSamples();
-    const int numChannels = buffer.getNumChannels();
 
-    // --- Save dry signal for mix blending ---
-    dryBuffer.makeCopyOf(buffer, true);
+    if (mix.isConstant())
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            auto* wetData = buffer.getWritePointer(ch);
+            juce::FloatVectorOperations::multiply(wetData, static_cast<SampleType>(mix.end), numSamples);
+            dryDelay.addDelayed(ch, wetData, numSamples, SampleType(1) - static_cast<SampleType>(mix.end));
+        }
+        return;
+    }
 
-    // --- 1. Input Trim ---
-    float inputGain = juce::Decibels::decibelsToGain(inputTrimDb);
-    buffer.applyGain(inputGain);
+    fillRamp(gainRamp.data(), numSamples, static_cast<SampleType>(mix.start), static_cast<SampleType>(mix.end));
+    const SampleType* mixRamp = gainRamp.data();
 
-    // --- 2. DC Blocker (pre) ---
-    for (int ch = 0; ch < numChannels; ++ch)
+    // wet = dry + mix * (wet - dry)
+    for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
     {
-        auto* data = buffer.getWritePointer(ch);
-        for (int i = 0; i < numSamples; ++i)
-            data[i] = preDCBlocker[static_cast<size_t>(ch)].process(data[i]);
+        auto* wetData = buffer.getWritePointer(ch);
+        auto* dryData = dryBuffer.getWritePointer(ch);
+
+        juce::FloatVectorOperations::clear(dryData, numSamples);
+        dryDelay.addDelayed(ch, dryData, numSamples, SampleType(1));
+
+        juce::FloatVectorOperations::subtract(wetData, dryData, numSamples);
+        juce::FloatVectorOperations::multiply(wetData, mixRamp, numSamples);
+        juce::FloatVectorOperations::add(wetData, dryData, numSamples);
     }
+}
+
+template <typename SampleType>
+void SaturatorDSP<SampleType>::process(juce::AudioBuffer<SampleType>& buffer,
+                                       const Parameters& params,
+                                       Mode mode,
+                                       QualitySetting quality)
+{
+   #if SATURATOR_PROFILE_STAGES
+    if (stageProfile != nullptr)
+        ++stageProfile->blocks;
+
+    const auto processStart = stageTrace != nullptr ? juce::Time::getHighResolutionTicks() : 0;
+   #endif
 
-    // --- 3. Pre-Emphasis EQ ---
-    updatePreEmphasis(currentSampleRate, mode);
+    if (meters != nullptr)
+        publishLevels(buffer, meters->inputPeak, meters->inputRms, inputMeanSquare);
+
+    // The chain runs one sub-block at a time, each with its slice of the
+    // parameter ramps
+    const int numSamples = buffer.getNumSamples();
+
+    if (numSamples <= currentBlockSize)
+    {
+        processChain(buffer, params, mode, quality);
+    }
+    else
     {
-        juce::dsp::AudioBlock<float> block(buffer);
-        juce::dsp::ProcessContextReplacing<float> ctx(block);
-        preHPF.process(ctx);
-        preMidBoost.process(ctx);
-        preHFShelf.process(ctx);
+        for (int first = 0; first < numSamples; first += currentBlockSize)
+        {
+            const int length = juce::jmin(currentBlockSize, numSamples - first);
+            juce::AudioBuffer<SampleType> subBlock(buffer.getArrayOfWritePointers(), buffer.getNumChannels(),
+                                                   first, length);
+
+            processChain(subBlock, sliceParameters(params, first, length, numSamples), mode, quality);
+        }
     }
 
-    // --- 4. Oversampling (up) ---
-    bool useTorture = (mode == Mode::Torture);
-    auto& oversampler = useTorture ? *oversampling8x : *oversampling4x;
+    if (meters != nullptr)
+    {
+        publishLevels(buffer, meters->outputPeak, meters->outputRms, outputMeanSquare);
+
+        const bool wetRunning = ! idle && ! wetChainIdle;
+        meters->sagReductionDb.store(wetRunning ? getSagReductionDb(params) : 0.0f,
+                                     std::memory_order_relaxed);
+    }
 
-    juce::dsp::AudioBlock<float> inputBlock(buffer);
-    auto oversampledBlock = oversampler.processSamplesUp(inputBlock);
+   #if SATURATOR_PROFILE_STAGES
+    if (stageTrace != nullptr)
+        stageTrace->push({ processStart, juce::Time::getHighResolutionTicks(), StageTrace::processEvent, numSamples });
+   #endif
+}
 
-    const int osNumSamples = static_cast<int>(oversampledBlock.getNumSamples());
-    const int osNumChannels = static_cast<int>(oversampledBlock.getNumChannels());
+template <typename SampleType>
+void SaturatorDSP<SampleType>::processChain(juce::AudioBuffer<SampleType>& buffer,
+                                            const Parameters& params,
+                                            Mode mode,
+                                            QualitySetting quality)
+{
+   #if SATURATOR_PROFILE_STAGES
+    lapStart = juce::Time::getHighResolutionTicks();
+   #endif
 
-    // --- 5 + 6 + 7. Drive, Valve Shaper, and Sag (at oversampled rate) ---
-    float driveLinear = std::pow(10.0f, driveDb / 20.0f);
-    auto valveParams = getValveParams(mode);
+    jassert(buffer.getNumChannels() <= currentNumChannels);
+    const int numSamples = buffer.getNumSamples();
 
-    double osRate = currentSampleRate * (useTorture ? 8.0 : 4.0);
-    for (auto& env : sagEnvelope) env.prepare(osRate);
+    // --- Idle bypass ---
+    if (updateSilence(buffer))
+    {
+        idle = true;
+        buffer.clear();
+        return;
+    }
 
-    for (int ch = 0; ch < osNumChannels; ++ch)
+    if (idle)
     {
-        auto* data = oversampledBlock.getChannelPointer(static_cast<size_t>(ch));
+        idle = false;
+        resetWetChain();
+        dryDelay.reset();
+        wetChainIdle = false;
+    }
 
-        for (int i = 0; i < osNumSamples; ++i)
-        {
-            float env = sagEnvelope[static_cast<size_t>(ch)].process(data[i]);
+    // Nothing is built or allocated here. A band count or setting prepare()
+    // has no oversamplers for runs as the count and first setting it has.
+    int numBands = juce::jlimit(1, maxBands, params.numBands);
+
+    if (numBands > preparedBands || ! isBuilt(quality, numBands))
+    {
+        jassertfalse;
+        numBands = bandsInUse;
+
+        if (! isBuilt(quality, numBands))
+            quality = qualitiesInUse.front();
+    }
 
-            float effectiveDrive = driveLinear * (1.0f - sagAmount * env);
+    // --- Dry tap ---
+    // A fully wet block stores only the history a later dry read can reach.
+    // A fully dry block skips the wet chain and outputs the delayed input.
+    const bool dryUnused = params.mix.start >= 1.0f && params.mix.end >= 1.0f;
+    const bool wetUnused = params.mix.start <= 0.0f && params.mix.end <= 0.0f;
 
-            float x = data[i] + bias;
-            x *= effectiveDrive;
+    dryDelay.setDelay(juce::roundToInt(getLatencyInSamples(quality)));
+    dryDelay.push(buffer, dryUnused);
+    SATURATOR_STAGE_LAP(DryCopy)
 
-            data[i] = valveShaper(x, valveParams.curvature, valveParams.asymmetry);
+    if (wetUnused)
+    {
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+        {
+            buffer.clear(ch, 0, numSamples);
+            dryDelay.addDelayed(ch, buffer.getWritePointer(ch), numSamples, SampleType(1));
         }
+
+        wetChainIdle = true;
+        SATURATOR_STAGE_LAP(Mix)
+        return;
+    }
+
+    // The wet chain restarts from silence rather than from stale state
+    if (wetChainIdle)
+    {
+        resetWetChain();
+        wetChainIdle = false;
     }
 
-    // --- 8. Downsample ---
-    juce::dsp::AudioBlock<float> outputBlock(buffer);
-    oversampler.processSamplesDown(outputBlock);
+    // --- 1 + 2 + 3. Input Trim, DC Blocker (pre), Pre-Emphasis EQ (fused) ---
+    setEmphasisMode(mode);
+    processPreChain(buffer, params.inputTrimDb, mode);
+    SATURATOR_STAGE_LAP(PreChain)
 
-    // --- 9. Post-Emphasis EQ ---
-    updatePostEmphasis(currentSampleRate, mode);
+    // --- Band split ---
+    // Changing the band count restarts every band from silence
+    if (numBands != activeBands)
     {
-        juce::dsp::AudioBlock<float> block(buffer);
-        juce::dsp::ProcessContextReplacing<float> ctx(block);
-        postLPF.process(ctx);
-        postLowShelf.process(ctx);
-        postPresenceDip.process(ctx);
+        activeBands = numBands;
+        resetBands();
     }
 
-    // --- 10. DC Blocker (post) ---
-    for (int ch = 0; ch < numChannels; ++ch)
+    // --- 4 - 8. Oversampled path(s), per band ---
+    if (activeBands == 1)
     {
-        auto* data = buffer.getWritePointer(ch);
-        for (int i = 0; i < numSamples; ++i)
-            data[i] = postDCBlocker[static_cast<size_t>(ch)].process(data[i]);
+        const BandParameters fullBand { params.driveDb, params.bias, params.sagAmount };
+        processBand(0, buffer, fullBand, mode, quality);
     }
+    else
+    {
+        splitBands(buffer, params);
+        SATURATOR_STAGE_LAP(PreChain)
 
-    // --- 11. Output Trim ---
-    float outputGain = juce::Decibels::decibelsToGain(outputTrimDb);
-    buffer.applyGain(outputGain);
+        // Bands share nothing from here to the sum, so they can run on the
+        // worker pool
+        auto runBand = [&](int b)
+        {
+            processBand(b, bandBuffers[static_cast<size_t>(b)], params.bands[static_cast<size_t>(b)], mode, quality);
+        };
 
-    // --- 12. Dry/Wet Mix ---
-    if (mix < 1.0f)
-    {
-        for (int ch = 0; ch < numChannels; ++ch)
+        if (runsBandsInParallel(numSamples))
+            workerPool->run(activeBands, threadCount - 1, runBand);
+        else
+            for (int b = 0; b < activeBands; ++b)
+                runBand(b);
+
+        for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
         {
-            auto* wetData = buffer.getWritePointer(ch);
-            const auto* dryData = dryBuffer.getReadPointer(ch);
-            for (int i = 0; i < numSamples; ++i)
-                wetData[i] = dryData[i] * (1.0f - mix) + wetData[i] * mix;
+            buffer.copyFrom(ch, 0, bandBuffers[0], ch, 0, numSamples);
+
+            for (int b = 1; b < activeBands; ++b)
+                buffer.addFrom(ch, 0, bandBuffers[static_cast<size_t>(b)], ch, 0, numSamples);
         }
     }
+
+    // --- 9 + 10 + 11. Post-Emphasis EQ, DC Blocker (post), Output Trim (fused) ---
+    processPostChain(buffer, params.outputTrimDb, mode);
+    SATURATOR_STAGE_LAP(PostChain)
+
+    // --- 12. Dry/Wet Mix ---
+    applyMix(buffer, params.mix);
+    SATURATOR_STAGE_LAP(Mix)
 }
+
+template class SaturatorDSP<float>;
+template class SaturatorDSP<double>;
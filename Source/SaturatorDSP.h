@@ -2,92 +2,624 @@
 
 #include <juce_dsp/juce_dsp.h>
 #include <juce_audio_basics/juce_audio_basics.h>
+#include "PolyphaseIIR.h"
+#include "ValveShaper.h"
+#include "WorkerPool.h"
+#include <atomic>
 
-class SaturatorDSP
+#if SATURATOR_PROFILE_STAGES
+class StageTrace;
+#endif
+
+// Types shared by every sample type of SaturatorDSP, so a float and a
+// double instance take the same modes and parameters. Parameters are
+// control values and stay float whatever the audio runs at.
+class SaturatorDSPBase
 {
 public:
     enum class Mode { Triode, Pentode, Torture };
 
+    // Standard runs the exact/fast shaper at 4x or 8x (by mode). The Live
+    // settings run the ADAA shaper at 2x (first order) or 1x (second order)
+    // for near-zero latency. The fixed settings run the exact/fast shaper at
+    // the same factor in every mode.
+    enum class Quality { Standard, Live2x, Live1x, Fixed2x, Fixed4x, Fixed8x, Fixed16x };
+    static constexpr int numQualities = 7;
+
+    // Up/down filters of the oversamplers. Polyphase IIR has the lowest
+    // latency. Half-band FIR is linear phase, at several times the latency.
+    enum class Filter { PolyphaseIIR, HalfBandFIR };
+    static constexpr int numFilters = 2;
+
+    // What the sag envelope follows: the rectified input, or its RMS level
+    enum class SagDetector { Peak, RMS };
+
+    // A quality and the filter its oversamplers use
+    struct QualitySetting
+    {
+        Quality quality = Quality::Standard;
+        Filter filter = Filter::PolyphaseIIR;
+
+        QualitySetting() = default;
+        QualitySetting(Quality q, Filter f = Filter::PolyphaseIIR) : quality(q), filter(f) {}
+
+        bool operator==(const QualitySetting& other) const { return quality == other.quality && filter == other.filter; }
+        bool operator!=(const QualitySetting& other) const { return ! operator==(other); }
+    };
+
+    // A parameter's movement across one block. The DSP ramps linearly from
+    // start and reaches end on the last sample, the way SmoothedValue does.
+    struct Ramp
+    {
+        float start = 0.0f;
+        float end = 0.0f;
+
+        Ramp() = default;
+        Ramp(float value) : start(value), end(value) {}
+        Ramp(float startValue, float endValue) : start(startValue), end(endValue) {}
+
+        bool isConstant() const { return juce::approximatelyEqual(start, end); }
+    };
+
+    // Drive, bias and sag of one band in the multiband modes. A band whose
+    // drive stays at 0 dB is off: it passes through clean and skips its
+    // oversampler and valve stage.
+    struct BandParameters
+    {
+        Ramp driveDb;
+        Ramp bias;
+        Ramp sagAmount;
+    };
+
+    static constexpr int maxBands = 3;
+
+    struct Parameters
+    {
+        Ramp inputTrimDb;
+        Ramp driveDb;
+        Ramp bias;
+        Ramp sagAmount;
+        Ramp outputTrimDb;
+        Ramp mix;
+
+        // 1 runs the full-band chain with driveDb, bias and sagAmount. 2 and
+        // 3 split at Linkwitz-Riley crossovers and take bands[] instead:
+        // low/high at lowCrossoverHz, or low/mid/high at both crossovers.
+        int numBands = 1;
+        float lowCrossoverHz = 200.0f;
+        float highCrossoverHz = 2500.0f;
+        std::array<BandParameters, maxBands> bands;
+    };
+
+    // Largest channel count prepare() accepts (7.1.4)
+    static constexpr int maxChannels = 12;
+
+    // Sub-block sizes SaturatorDSP::setSubBlockSize() accepts
+    static constexpr int defaultSubBlockSize = 128;
+    static constexpr int minSubBlockSize = 32;
+    static constexpr int maxSubBlockSize = 1024;
+
+    // Stages of process(), in signal order
+    enum class Stage
+    {
+        DryCopy, PreChain, Upsample, ValveStage, Downsample, PostChain, Mix, numStages
+    };
+    static const char* getStageName(Stage stage);
+
+    // Levels for the editor's meters, published by process() once per block.
+    // The audio thread is the only writer. Peaks hold their maximum until a
+    // reader takes them; RMS and sag reduction are overwritten every block.
+    struct Meters
+    {
+        std::atomic<float> inputPeak { 0.0f };     // linear
+        std::atomic<float> outputPeak { 0.0f };
+        std::atomic<float> inputRms { 0.0f };      // linear, 300 ms window
+        std::atomic<float> outputRms { 0.0f };
+        std::atomic<float> sagReductionDb { 0.0f }; // largest across channels
+
+        // The highest peak since the last call
+        static float takePeak(std::atomic<float>& peak) { return peak.exchange(0.0f, std::memory_order_relaxed); }
+    };
+    static_assert(std::atomic<float>::is_always_lock_free, "Meters must be lock-free");
+
+   #if SATURATOR_PROFILE_STAGES
+    // High-resolution ticks spent in each stage, accumulated by process()
+    // while a profile is attached. Compiled into tool builds only.
+    struct StageProfile
+    {
+        std::array<juce::int64, static_cast<size_t>(Stage::numStages)> ticks {};
+        juce::int64 blocks = 0;
+    };
+   #endif
+
+protected:
+    // --- Valve Waveshaper ---
+    struct ValveParams
+    {
+        float curvature;
+        float asymmetry;
+    };
+
+    static constexpr ValveParams getValveParams(Mode mode)
+    {
+        switch (mode)
+        {
+            case Mode::Triode:  return { 2.5f, 0.5f };
+            case Mode::Pentode: return { 4.0f, 0.85f };
+            case Mode::Torture: return { 8.0f, 0.7f };
+            default:            return { 4.0f, 0.5f };
+        }
+    }
+
+    static constexpr int getOversamplingFactor(Mode mode, Quality quality)
+    {
+        switch (quality)
+        {
+            case Quality::Live1x:   return 1;
+            case Quality::Live2x:
+            case Quality::Fixed2x:  return 2;
+            case Quality::Fixed4x:  return 4;
+            case Quality::Fixed8x:  return 8;
+            case Quality::Fixed16x: return 16;
+            case Quality::Standard:
+            default:                return mode == Mode::Torture ? 8 : 4;
+        }
+    }
+
+    static constexpr bool usesADAA(Quality quality)
+    {
+        return quality == Quality::Live2x || quality == Quality::Live1x;
+    }
+
+    // First-order ADAA at 2x delays Live 2x by a quarter sample at the host
+    // rate. A Thiran allpass adds the rest of a whole sample, so every
+    // setting has integer latency and hosts can compensate it exactly.
+    static constexpr float live2xPadDelay = 0.75f;
+
+    // In the multiband modes the low band runs at 1x and a mid band at up
+    // to 2x; their harmonics have far less to fold back. The top band takes
+    // the quality's factor. ADAA qualities keep one factor for every band so
+    // all bands share the same fractional delay.
+    static constexpr int getBandFactor(Mode mode, Quality quality, int band, int numBands)
+    {
+        const int factor = getOversamplingFactor(mode, quality);
+
+        if (usesADAA(quality) || band == numBands - 1)
+            return factor;
+
+        const int bandLimit = band == 0 ? 1 : 2;
+        return factor < bandLimit ? factor : bandLimit;
+    }
+
+    // A mode's curve as compile-time constants. The valve stage is
+    // instantiated per mode with these, and per oversampling factor.
+    template <Mode mode>
+    struct Voicing
+    {
+        static constexpr float curvature = getValveParams(mode).curvature;
+        static constexpr float asymmetry = getValveParams(mode).asymmetry;
+    };
+};
+
+// The saturator for one sample type. Instantiated for float and double.
+template <typename SampleType>
+class SaturatorDSP : public SaturatorDSPBase
+{
+public:
     SaturatorDSP();
 
+    // The settings and band count process() will run with. prepare() builds
+    // their oversamplers at that count and drops any others. process()
+    // never builds or allocates; another setting or band count runs as the
+    // first listed setting at the listed count.
+    void setQualitiesInUse(const std::vector<QualitySetting>& qualities, int numBands = 1);
+
     void prepare(double sampleRate, int samplesPerBlock, int numChannels);
     void reset();
 
-    void process(juce::AudioBuffer<float>& buffer,
-                 float inputTrimDb,
-                 float driveDb,
-                 float bias,
-                 float sagAmount,
-                 float outputTrimDb,
-                 float mix,
-                 Mode mode);
+    // Threads a multiband block may use, the caller's included, up to one
+    // per band. With more than one, prepare() takes the shared worker pool
+    // and the bands of each sub-block of at least minParallelSamples run
+    // side by side. Meant for offline renders; 1 (the default) runs
+    // serially. Lowering the count takes effect at once, raising it past 1
+    // at the next prepare().
+    void setThreadCount(int numThreads);
+    static constexpr int minParallelSamples = 64;
+
+    // Largest number of samples the chain runs at once. process() splits
+    // longer host blocks, so the oversampled working set stays in cache and
+    // blocks beyond the size given to prepare() are safe. Clamped to
+    // minSubBlockSize..maxSubBlockSize; takes effect at the next prepare().
+    void setSubBlockSize(int samples);
+
+    void process(juce::AudioBuffer<SampleType>& buffer,
+                 const Parameters& params,
+                 Mode mode,
+                 QualitySetting quality = {});
+
+    // Latency depends on the quality and filter only. Every mode of a
+    // quality reports the same value, so mode automation never changes it.
+    // Valid once the setting's oversamplers are built.
+    float getLatencyInSamples(QualitySetting quality = {}) const;
+
+    // How long the output keeps ringing after the input stops: the longest
+    // latency plus DC blocker and emphasis EQ ring-out to -120 dB, or the
+    // sag release if that is longer. Valid after prepare().
+    double getTailLengthSeconds() const;
+
+    // Selects the exact std::tanh shaper or the SIMD rational approximation.
+    void setShaperKernel(ValveShaper::Kernel kernel);
 
-    float getLatencyInSamples(Mode mode) const;
+    // Selects peak or RMS sag detection. Linked channels share one envelope
+    // that follows the loudest channel. The default is peak, unlinked.
+    void setSagDetection(SagDetector detector, bool linked);
+
+    // Attaches the meters process() publishes to, or detaches with nullptr.
+    // Nothing is measured while detached.
+    void setMeters(Meters* metersToUse);
+
+   #if SATURATOR_PROFILE_STAGES
+    void setStageProfile(StageProfile* profileToUse);
+
+    // Attaches a trace that receives every stage lap and process() call as
+    // a timed event, or detaches with nullptr
+    void setStageTrace(StageTrace* traceToUse);
+   #endif
 
 private:
     double currentSampleRate = 44100.0;
-    int currentBlockSize = 512;
+    int currentBlockSize = 512;   // sub-block size in use, at most subBlockSize
     int currentNumChannels = 2;
+    int subBlockSize = defaultSubBlockSize;
 
     // --- DC Blockers (one-pole HPF at ~5 Hz) ---
     struct DCBlocker
     {
-        float x1 = 0.0f;
-        float y1 = 0.0f;
-        float coeff = 0.0f;
+        SampleType x1 = 0;
+        SampleType y1 = 0;
+        SampleType coeff = 0;
 
         void prepare(double sampleRate);
         void reset();
-        float process(float x);
     };
-    std::array<DCBlocker, 2> preDCBlocker;
-    std::array<DCBlocker, 2> postDCBlocker;
+    std::vector<DCBlocker> preDCBlocker;
+    std::vector<DCBlocker> postDCBlocker;
+
+    // --- Pre/Post-Emphasis EQ ---
+    // Three transposed direct form II biquads per side. The fused chain
+    // kernels run trim, DC blocker and the cascade in a single pass per
+    // channel group, with all filter state held in locals.
+    using BiquadCoefficients = std::array<SampleType, 5>;   // b0, b1, b2, a1, a2
+    using EmphasisSet = std::array<BiquadCoefficients, 3>;
+
+    struct BiquadState
+    {
+        SampleType s1 = 0;
+        SampleType s2 = 0;
+    };
+    using CascadeState = std::array<BiquadState, 3>;
+
+    std::vector<CascadeState> preEmphasisState;
+    std::vector<CascadeState> postEmphasisState;
 
-    // --- Pre-Emphasis EQ ---
-    using IIRFilter = juce::dsp::ProcessorDuplicator<
-        juce::dsp::IIR::Filter<float>,
-        juce::dsp::IIR::Coefficients<float>>;
+    // --- Emphasis coefficient tables ---
+    // All modes are designed once per sample rate and shared, read-only, by
+    // every instance running at that rate. A mode change interpolates the
+    // coefficients over a short fade; the biquad stability triangle is
+    // convex, so every intermediate set is stable too.
+    static constexpr int numModes = 3;
 
-    IIRFilter preHPF;
-    IIRFilter preMidBoost;
-    IIRFilter preHFShelf;
+    struct CoefficientTables
+    {
+        std::array<EmphasisSet, numModes> preEmphasis;
+        std::array<EmphasisSet, numModes> postEmphasis;
+    };
+    std::shared_ptr<const CoefficientTables> tables;
 
-    // --- Post-Emphasis EQ ---
-    IIRFilter postLPF;
-    IIRFilter postLowShelf;
-    IIRFilter postPresenceDip;
+    static std::shared_ptr<const CoefficientTables> getSharedTables(double sampleRate);
+
+    Mode emphasisMode = Mode::Triode;
+    EmphasisSet preEmphasisCurrent {}, postEmphasisCurrent {};
+    EmphasisSet preEmphasisStart {}, postEmphasisStart {};
+    int emphasisFadeLength = 0;
+    int emphasisFadePosition = 0;
+    static constexpr int emphasisFadeChunk = 32;
 
     // --- Oversampling ---
-    std::unique_ptr<juce::dsp::Oversampling<float>> oversampling4x;
-    std::unique_ptr<juce::dsp::Oversampling<float>> oversampling8x;
+    // One slot per band and stage count (2x to 16x) for each filter, each
+    // built only when a setting in use needs it. Bands never share an
+    // oversampler. Polyphase IIR runs on PolyphaseIIR, which shapes inside
+    // its up/down loop one tile at a time; half-band FIR runs on JUCE's
+    // oversampler, which materialises the whole oversampled block.
+    static constexpr int maxStages = PolyphaseIIR<SampleType>::maxStages;
+
+    std::array<std::unique_ptr<PolyphaseIIR<SampleType>>, static_cast<size_t>(maxBands * maxStages)> polyphaseOversamplers;
+    std::array<std::unique_ptr<juce::dsp::Oversampling<SampleType>>, static_cast<size_t>(maxBands * maxStages)> halfBandOversamplers;
+    std::vector<QualitySetting> qualitiesInUse { QualitySetting {} };
+    int bandsInUse = 1;
+    bool prepared = false;
+
+    static int getOversamplerSlot(int band, int factor);
+    bool hasOversampler(int band, int factor, Filter filter) const;
+    bool isBuilt(QualitySetting quality, int numBands) const;
+    void buildOversamplers(QualitySetting quality, int numBands);
+    void buildQualitiesInUse();
+    float getMaxBuiltLatency() const;
+    int getMaxBlockFactor() const;
+    void updateBuiltBounds();
 
     // --- Sag Envelope Follower ---
+    // Runs at the host rate on the band's input, ahead of the oversampler.
+    // The drive gain 1 - sag * envelope is taken every sagControlInterval
+    // host samples and ramped linearly in between at the path's rate.
+    static constexpr int sagControlInterval = 16;
+    static constexpr int maxSagSegments = maxSubBlockSize / sagControlInterval;
+    static constexpr int sagGainStride = maxSagSegments + 1;
+
     struct EnvelopeFollower
     {
-        float envelope = 0.0f;
-        float attackCoeff = 0.0f;
-        float releaseCoeff = 0.0f;
+        SampleType envelope = 0;
+        SampleType meanSquare = 0;   // RMS detection only
+        SampleType gain = 1;         // sag gain at the end of the last block
+        SampleType attackCoeff = 0;
+        SampleType releaseCoeff = 0;
+        SampleType rmsCoeff = 0;
 
         void prepare(double sampleRate);
         void reset();
-        float process(float input);
     };
-    std::array<EnvelopeFollower, 2> sagEnvelope;
+
+    SagDetector sagDetector = SagDetector::Peak;
+    bool sagLinked = false;
+
+    // --- Cached dB conversions ---
+    // Linear gain of a dB control, converted again only when the control
+    // moves. A ramp's end is the next block's start, so one entry serves a
+    // steady control and the start of a moving one. 0 dB is unity in every
+    // conversion used, so the entry starts out valid.
+    struct GainCache
+    {
+        float db = 0.0f;
+        SampleType gain = 1;
+
+        template <typename Convert>
+        SampleType get(float dB, Convert convert);
+    };
 
     // --- Valve Waveshaper ---
-    struct ValveParams
+    ValveShaper::Kernel shaperKernel = ValveShaper::Kernel::Fast;
+
+    // --- Channel groups ---
+    // Channels are processed laneCount at a time, interleaved so that each
+    // SIMD lane carries one channel through the DC blockers, biquads, sag
+    // envelope and shaper. A last group of one channel runs in scalar code.
+   #if JUCE_USE_SIMD
+    static constexpr int laneCount = static_cast<int>(juce::dsp::SIMDRegister<SampleType>::SIMDNumElements);
+   #else
+    static constexpr int laneCount = 1;
+   #endif
+
+    // --- Scratch ---
+    // Working buffers of one band's path: the interleaved group (laneCount
+    // channels) and the per-sample ramps, sized for a whole sub-block at the
+    // highest built FIR rate and for at least one polyphase tile (the sag
+    // ramp is per lane), the sag gains at the control points per channel,
+    // the polyphase tile pair with a deinterleaved copy for ADAA, and a
+    // host-rate buffer for crossfades and priming. Serial processing runs
+    // everything on the first set; with worker threads each prepared band
+    // has its own.
+    struct Scratch
     {
-        float curvature;
-        float asymmetry;
+        std::vector<SampleType> lanes;
+        std::vector<SampleType> driveRamp;
+        std::vector<SampleType> biasRamp;
+        std::vector<SampleType> sagRamp;
+        std::vector<SampleType> sagGains;
+        std::vector<SampleType> tiles;
+        std::vector<SampleType> tileChannels;
+        juce::AudioBuffer<SampleType> transition;
+    };
+    std::array<Scratch, maxBands> scratch;
+    int scratchFactor = 0;
+
+    Scratch& getScratch(int band) { return scratch[workerPool != nullptr ? static_cast<size_t>(band) : 0]; }
+    void resizeScratch(int factor);
+
+    // --- Worker threads ---
+    int threadCount = 1;
+    std::shared_ptr<WorkerPool> workerPool;
+
+    bool runsBandsInParallel(int numSamples) const;
+
+    // --- Oversampled paths and mode transitions ---
+    // A path is one oversampling factor and filter plus the state that
+    // runs at its rate. When a mode or quality change needs a different
+    // factor or filter, the idle path is primed with the last primeLength
+    // input samples, takes over the active path's sag envelope, and is
+    // crossfaded in while the old path keeps running. Each path is delayed
+    // to the longest factor of its quality, so both paths line up during
+    // the fade.
+    static constexpr int maxLatencyPad = 512;
+    static constexpr int primeLength = 256;
+
+    struct Path
+    {
+        int band = 0;
+        int factor = 0;
+        Mode mode = Mode::Triode;
+        Quality quality = Quality::Standard;
+        Filter filter = Filter::PolyphaseIIR;
+        std::vector<EnvelopeFollower> sagEnvelope;
+        std::vector<ValveShaper::ADAA> adaaShaper;
+        juce::dsp::DelayLine<SampleType, juce::dsp::DelayLineInterpolationTypes::None> latencyPad { maxLatencyPad };
+        int latencyPadSamples = 0;
+        GainCache drive;
+
+        // Thiran allpass state per channel, Live 2x only
+        struct FractionalPad
+        {
+            SampleType x1 = 0;
+            SampleType y1 = 0;
+        };
+        std::vector<FractionalPad> fractionalPad;
     };
-    static ValveParams getValveParams(Mode mode);
-    static float valveShaper(float x, float a, float b);
+
+    // --- Bands ---
+    // Every band owns a pair of paths and runs its own transitions. The
+    // full-band chain is band 0 alone. In the multiband modes the pre-chain
+    // output is split with Linkwitz-Riley crossovers (the low band is
+    // allpass-compensated for the upper crossover), so the bands sum flat.
+    // An off band is read back clean from its cleanDelays entry at the wet
+    // latency. Bands beyond preparedBands hold no buffers yet.
+    struct Band
+    {
+        std::array<Path, 2> paths;
+        int activePath = 0;
+        bool pathsConfigured = false;
+        int transitionPosition = 0;
+
+        juce::AudioBuffer<SampleType> primeHistory;
+        int primeHistoryLength = 0;
+
+        bool bypassed = false;
+        int bypassFadePosition = 0;
+        BandParameters heldParameters;
+    };
+    std::array<Band, maxBands> bands;
+    int activeBands = 1;
+    int preparedBands = 0;
+
+    juce::dsp::LinkwitzRileyFilter<SampleType> lowSplit, highSplit, lowAllpass;
+    std::array<juce::AudioBuffer<SampleType>, maxBands> bandBuffers;
+
+    int transitionLength = 0;
+
+    PolyphaseIIR<SampleType>* getPolyphaseOversampler(int band, int factor) const;
+    juce::dsp::Oversampling<SampleType>* getHalfBandOversampler(int band, int factor) const;
+    int getPathLatency(int factor, Filter filter) const;
+    int getAlignedPathLatency(QualitySetting quality) const;
+
+    void configurePath(Path& path, Mode mode, QualitySetting quality);
+    void primePath(Band& band, Path& path, const BandParameters& params);
+    void startTransition(Band& band, Mode mode, QualitySetting quality, const BandParameters& params);
+    void pushPrimeHistory(Band& band, const juce::AudioBuffer<SampleType>& buffer);
+    void runPath(Path& path, juce::AudioBuffer<SampleType>& buffer, const BandParameters& params);
+    void runSagDetector(Path& path, const juce::AudioBuffer<SampleType>& buffer, const Ramp& sagAmount);
+
+    void splitBands(const juce::AudioBuffer<SampleType>& buffer, const Parameters& params);
+    void processBand(int index, juce::AudioBuffer<SampleType>& buffer, const BandParameters& params,
+                     Mode mode, QualitySetting quality);
+    void prepareBands(int numBands);
+    void resetBands();
 
     // --- Internal helpers ---
-    void updatePreEmphasis(double sampleRate, Mode mode);
-    void updatePostEmphasis(double sampleRate, Mode mode);
+    static EmphasisSet designPreEmphasis(double sampleRate, Mode mode);
+    static EmphasisSet designPostEmphasis(double sampleRate, Mode mode);
+    static BiquadCoefficients toBiquad(const juce::dsp::IIR::Coefficients<SampleType>& coefficients);
+
+    void setEmphasisMode(Mode mode);
+    int advanceEmphasisFade(int maxChunk, int& fadePosition, EmphasisSet& current,
+                            const EmphasisSet& start, const EmphasisSet& target) const;
+
+    const SampleType* makeGainRamp(const Ramp& gainDb, int numSamples, GainCache& cache, SampleType& constantGain);
+    void processPreChain(juce::AudioBuffer<SampleType>& buffer, const Ramp& inputTrimDb, Mode mode);
+    void processPostChain(juce::AudioBuffer<SampleType>& buffer, const Ramp& outputTrimDb, Mode mode);
+
+    // Dispatches to the valve stage instantiated for the path's mode, and
+    // within it for the path's oversampling factor. The block is at the
+    // path's rate, or at the host rate when polyphase is given: the valve
+    // stage then runs inside its up/down loop.
+    void processValveStage(juce::dsp::AudioBlock<SampleType>& block, Path& path,
+                           const BandParameters& params, PolyphaseIIR<SampleType>* polyphase);
+
+    template <Mode mode>
+    void processValveStage(juce::dsp::AudioBlock<SampleType>& block, Path& path,
+                           const BandParameters& params, PolyphaseIIR<SampleType>* polyphase);
+
+    template <Mode mode, int factor>
+    void processValveGroups(juce::dsp::AudioBlock<SampleType>& block, Path& path,
+                            const BandParameters& params, PolyphaseIIR<SampleType>* polyphase);
+
+    // --- Idle bypass ---
+    // Each channel counts how long its input has stayed below
+    // silenceThreshold. Once every channel has been silent for longer than
+    // the tail, process() clears the output and skips everything else. The
+    // first non-silent block restarts the chain from cleared state.
+    static constexpr float silenceThreshold = 1.0e-5f;   // -100 dBFS
+    std::vector<int> silentSamples;
+    int tailSamples = 0;
+    bool idle = false;
+
+    bool updateSilence(const juce::AudioBuffer<SampleType>& buffer);
+    int computeTailSamples() const;
+
+    void resetWetChain();
+    void applyMix(juce::AudioBuffer<SampleType>& buffer, const Ramp& mix);
+
+    // --- Dry path ---
+    // Ring buffer of the input, read back at the wet latency so a parallel
+    // mix lines up with the wet signal. Reads go straight from the ring into
+    // the output. Every setting has integer latency, so no read
+    // interpolates.
+    struct DryDelay
+    {
+        void prepare(int numChannels, int maxBlockSize, int maxDelay);
+        void reset();
+        void setDelay(int delayInSamples);
+
+        // Stores the block. With historyOnly, just the tail a later read can
+        // reach is written.
+        void push(const juce::AudioBuffer<SampleType>& input, bool historyOnly);
+
+        // dest[i] += gain * delayed input, for the block last pushed
+        void addDelayed(int channel, SampleType* dest, int numSamples, SampleType gain) const;
+
+    private:
+        juce::AudioBuffer<SampleType> ring;
+        int mask = 0;
+        int writePosition = 0;
+        int blockStart = 0;
+        int maxHistory = 0;
+        int delay = 0;
+    };
+    DryDelay dryDelay;
+    std::array<DryDelay, maxBands> cleanDelays;
+    int dryDelayCapacity = 0;
+    bool wetChainIdle = false;
+
+    // Dry signal for ramped mixes
+    juce::AudioBuffer<SampleType> dryBuffer;
+
+    // Per-sample gain ramp at the host rate
+    std::vector<SampleType> gainRamp;
+    GainCache inputTrimGain, outputTrimGain;
+
+    // --- Metering ---
+    // Levels are taken from the host-rate buffers around the chain, so the
+    // oversampled loops do no extra work
+    static constexpr double rmsWindowSeconds = 0.3;
+
+    Meters* meters = nullptr;
+    double inputMeanSquare = 0.0;
+    double outputMeanSquare = 0.0;
+
+    // One-pole decay over a block, for the block length it was worked out for
+    int rmsDecaySamples = 0;
+    double rmsDecay = 1.0;
+
+    void processChain(juce::AudioBuffer<SampleType>& buffer, const Parameters& params,
+                      Mode mode, QualitySetting quality);
+    void publishLevels(const juce::AudioBuffer<SampleType>& buffer, std::atomic<float>& peak,
+                       std::atomic<float>& rms, double& meanSquare);
+    float getSagReductionDb(const Parameters& params) const;
+
+   #if SATURATOR_PROFILE_STAGES
+    StageProfile* stageProfile = nullptr;
+    StageTrace* stageTrace = nullptr;
+    juce::int64 lapStart = 0;
 
-    juce::AudioBuffer<float> dryBuffer;
+    void lapStage(Stage stage);
+   #endif
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SaturatorDSP)
 };
@@ -0,0 +1,140 @@
+#include "StageTrace.h"
+#include "SaturatorDSP.h"
+#include <limits>
+
+StageTrace::StageTrace(const juce::String& traceName, int capacity, int maxCollected)
+    : name(traceName),
+      ring(static_cast<size_t>(juce::nextPowerOfTwo(juce::jmax(2, capacity)))),
+      mask(static_cast<juce::uint64>(ring.size() - 1)),
+      maxEvents(static_cast<size_t>(juce::jmax(0, maxCollected)))
+{
+}
+
+StageTrace::~StageTrace()
+{
+    stopCollecting();
+}
+
+void StageTrace::push(const Event& event) noexcept
+{
+    const auto write = writeIndex.load(std::memory_order_relaxed);
+
+    if (write - readIndex.load(std::memory_order_acquire) > mask)
+    {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    ring[static_cast<size_t>(write & mask)] = event;
+    writeIndex.store(write + 1, std::memory_order_release);
+}
+
+int StageTrace::collect()
+{
+    const auto read = readIndex.load(std::memory_order_relaxed);
+    const auto write = writeIndex.load(std::memory_order_acquire);
+
+    for (auto i = read; i != write; ++i)
+    {
+        if (events.size() < maxEvents)
+            events.push_back(ring[static_cast<size_t>(i & mask)]);
+        else
+            dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    readIndex.store(write, std::memory_order_release);
+    return static_cast<int>(write - read);
+}
+
+void StageTrace::startCollecting(int intervalMs)
+{
+    stopCollecting();
+
+    collecting = true;
+    collector = std::thread([this, intervalMs]
+    {
+        std::unique_lock<std::mutex> lock(collectorLock);
+
+        while (collecting)
+        {
+            collectorWake.wait_for(lock, std::chrono::milliseconds(intervalMs));
+            collect();
+        }
+    });
+}
+
+void StageTrace::stopCollecting()
+{
+    if (! collector.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(collectorLock);
+        collecting = false;
+        collectorWake.notify_one();
+    }
+
+    collector.join();
+    collect();
+}
+
+// Complete ("X") events in microseconds. Each trace is a thread of one
+// process, named after the trace; process() events enclose their stages,
+// so the viewer nests them.
+bool StageTrace::writeChromeTrace(const juce::File& file, const std::vector<const StageTrace*>& traces)
+{
+    juce::FileOutputStream out(file);
+
+    if (! out.openedOk())
+        return false;
+
+    out.setPosition(0);
+    out.truncate();
+
+    auto origin = std::numeric_limits<juce::int64>::max();
+    juce::int64 totalDropped = 0;
+
+    for (const auto* trace : traces)
+    {
+        for (const auto& event : trace->events)
+            origin = juce::jmin(origin, event.start);
+
+        totalDropped += trace->getNumDropped();
+    }
+
+    const double microsecondsPerTick = 1.0e6 / static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+    auto toMicroseconds = [&](juce::int64 ticks) { return juce::String(static_cast<double>(ticks) * microsecondsPerTick, 3); };
+
+    out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":" << totalDropped << "},\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Saturator\"}}";
+
+    for (size_t t = 0; t < traces.size(); ++t)
+    {
+        const auto& trace = *traces[t];
+        const auto tid = juce::String(static_cast<int>(t) + 1);
+
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":" << juce::JSON::toString(trace.name) << "}}";
+
+        for (const auto& event : trace.events)
+        {
+            const bool isProcess = event.stage == processEvent;
+            const char* eventName = isProcess ? "process"
+                                              : SaturatorDSPBase::getStageName(static_cast<SaturatorDSPBase::Stage>(event.stage));
+
+            out << ",\n{\"name\":\"" << eventName << "\",\"cat\":\"" << (isProcess ? "block" : "stage")
+                << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                << ",\"ts\":" << toMicroseconds(event.start - origin)
+                << ",\"dur\":" << toMicroseconds(event.end - event.start);
+
+            if (isProcess)
+                out << ",\"args\":{\"samples\":" << event.numSamples << "}";
+
+            out << "}";
+        }
+    }
+
+    out << "\n]}\n";
+    out.flush();
+    return out.getStatus().wasOk();
+}
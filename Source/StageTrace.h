@@ -0,0 +1,80 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Timeline of where SaturatorDSP::process spends its time, for builds with
+// SATURATOR_PROFILE_STAGES. While a trace is attached, the audio thread
+// pushes one event per stage lap and one per process() call into a
+// lock-free single-producer ring. A reader drains the ring with collect(),
+// by hand or on the collecting thread, and writeChromeTrace() saves
+// everything collected as Chrome trace JSON for chrome://tracing or
+// ui.perfetto.dev.
+//
+// One thread pushes at a time: a traced instance keeps its bands serial.
+// A full ring drops events rather than blocking, and counts them.
+class StageTrace
+{
+public:
+    struct Event
+    {
+        juce::int64 start = 0;   // high-resolution ticks
+        juce::int64 end = 0;
+        int stage = 0;           // a SaturatorDSPBase::Stage, or processEvent
+        int numSamples = 0;      // process() events only
+    };
+
+    // Stage of an event that spans a whole process() call
+    static constexpr int processEvent = -1;
+
+    // The name labels the trace's track. The ring holds at least capacity
+    // events between collections; at most maxCollected are kept in all.
+    explicit StageTrace(const juce::String& name, int capacity = 1 << 16, int maxCollected = 1 << 22);
+    ~StageTrace();
+
+    const juce::String& getName() const { return name; }
+
+    // Audio thread. Does not block or allocate.
+    void push(const Event& event) noexcept;
+
+    // Reader thread. Moves the events pushed so far out of the ring and
+    // returns how many.
+    int collect();
+
+    // Collects every intervalMs on a thread of its own. Stopping collects
+    // once more after the thread has finished.
+    void startCollecting(int intervalMs = 50);
+    void stopCollecting();
+
+    const std::vector<Event>& getEvents() const { return events; }
+    juce::int64 getNumDropped() const { return dropped.load(std::memory_order_relaxed); }
+
+    // Writes the collected events of each trace as one track, on a shared
+    // time axis. Collection must be stopped. Returns false if the file
+    // cannot be written.
+    static bool writeChromeTrace(const juce::File& file, const std::vector<const StageTrace*>& traces);
+    bool writeChromeTrace(const juce::File& file) const { return writeChromeTrace(file, { this }); }
+
+private:
+    juce::String name;
+
+    std::vector<Event> ring;
+    juce::uint64 mask = 0;
+    std::atomic<juce::uint64> writeIndex { 0 };
+    std::atomic<juce::uint64> readIndex { 0 };
+    std::atomic<juce::int64> dropped { 0 };
+
+    std::vector<Event> events;   // reader side
+    size_t maxEvents = 0;
+
+    std::thread collector;
+    std::mutex collectorLock;
+    std::condition_variable collectorWake;
+    bool collecting = false;     // guarded by collectorLock
+
+    JUCE_DECLARE_NON_COPYABLE(StageTrace)
+};
@@ -0,0 +1,171 @@
+#include "ValveShaper.h"
+#include <cmath>
+
+namespace
+{
+    // Below this input spacing the ADAA divided differences lose precision
+    // and the midpoint fallbacks take over.
+    constexpr double adaaTolerance = 1.0e-4;
+    constexpr double ln2 = 0.693147180559945309417;
+
+    double halfSlope(double x, double a, double b)
+    {
+        return a * (x >= 0.0 ? 1.0 + b : 1.0 - b);
+    }
+
+    // Li2(1 - e^-t) for t in [0, ln 2], Bernoulli series up to t^13
+    double dilogFromLog(double t)
+    {
+        const double t2 = t * t;
+        return t * (1.0 + t * (-1.0 / 4.0 + t * (1.0 / 36.0
+                 + t2 * (-1.0 / 3600.0 + t2 * (1.0 / 211680.0
+                 + t2 * (-1.0 / 10886400.0 + t2 * (1.0 / 526901760.0
+                 + t2 * (-691.0 / 16999766784000.0))))))));
+    }
+
+    // log(cosh(u)) and its integral from 0 to u, without overflow for large u
+    void logCoshAndIntegral(double u, double& logCosh, double& integral)
+    {
+        const double au = std::abs(u);
+        const double t = std::log1p(std::exp(-2.0 * au));
+
+        logCosh = au - ln2 + t;
+
+        // Li2(-e^-2u) = -Li2(1 - e^-t) - t^2 / 2, via Landen's identity
+        const double li2 = -dilogFromLog(t) - 0.5 * t * t;
+        const double g = 0.5 * au * au - au * ln2 + 0.5 * li2
+                       + juce::MathConstants<double>::pi * juce::MathConstants<double>::pi / 24.0;
+
+        integral = (u < 0.0) ? -g : g;
+    }
+}
+
+double ValveShaper::antiderivative1(double x, double a, double b)
+{
+    const double k = halfSlope(x, a, b);
+    double logCosh, integral;
+    logCoshAndIntegral(k * x, logCosh, integral);
+    return logCosh / k;
+}
+
+double ValveShaper::antiderivative2(double x, double a, double b)
+{
+    const double k = halfSlope(x, a, b);
+    double logCosh, integral;
+    logCoshAndIntegral(k * x, logCosh, integral);
+    return integral / (k * k);
+}
+
+//==============================================================================
+// Antiderivative anti-aliasing
+//==============================================================================
+
+void ValveShaper::ADAA::reset()
+{
+    x1 = x2 = 0.0;
+    ad1x1 = ad2x1 = d1x1 = 0.0;
+    lastA = lastB = 0.0f;
+    lastOrder = 0;
+}
+
+void ValveShaper::ADAA::refreshCachedTerms(double a, double b)
+{
+    ad1x1 = antiderivative1(x1, a, b);
+    ad2x1 = antiderivative2(x1, a, b);
+
+    if (std::abs(x1 - x2) < adaaTolerance)
+        d1x1 = antiderivative1(0.5 * (x1 + x2), a, b);
+    else
+        d1x1 = (ad2x1 - antiderivative2(x2, a, b)) / (x1 - x2);
+}
+
+double ValveShaper::ADAA::processFirstOrder(double x0, double a, double b)
+{
+    const double ad1x0 = antiderivative1(x0, a, b);
+
+    double y;
+    if (std::abs(x0 - x1) < adaaTolerance)
+    {
+        const double mid = 0.5 * (x0 + x1);
+        y = std::tanh(halfSlope(mid, a, b) * mid);
+    }
+    else
+    {
+        y = (ad1x0 - ad1x1) / (x0 - x1);
+    }
+
+    x2 = x1;
+    x1 = x0;
+    ad1x1 = ad1x0;
+    return y;
+}
+
+double ValveShaper::ADAA::processSecondOrder(double x0, double a, double b)
+{
+    const double ad2x0 = antiderivative2(x0, a, b);
+
+    const double d1x0 = (std::abs(x0 - x1) < adaaTolerance)
+        ? antiderivative1(0.5 * (x0 + x1), a, b)
+        : (ad2x0 - ad2x1) / (x0 - x1);
+
+    double y;
+    if (std::abs(x0 - x2) < adaaTolerance)
+    {
+        // x0 ~= x2: expand around their midpoint instead of dividing by ~0
+        const double xBar = 0.5 * (x0 + x2);
+        const double delta = xBar - x1;
+
+        if (std::abs(delta) < adaaTolerance)
+        {
+            const double mid = 0.5 * (xBar + x1);
+            y = std::tanh(halfSlope(mid, a, b) * mid);
+        }
+        else
+        {
+            y = (2.0 / delta) * (antiderivative1(xBar, a, b)
+                                 + (ad2x1 - antiderivative2(xBar, a, b)) / delta);
+        }
+    }
+    else
+    {
+        y = 2.0 * (d1x0 - d1x1) / (x0 - x2);
+    }
+
+    x2 = x1;
+    x1 = x0;
+    ad2x1 = ad2x0;
+    d1x1 = d1x0;
+    return y;
+}
+
+template <typename SampleType>
+void ValveShaper::ADAA::process(SampleType* data, int numSamples, float a, float b)
+{
+    const double ad = static_cast<double>(a);
+    const double bd = static_cast<double>(b);
+
+    // Cached antiderivatives depend on the curve and order, so rebuild them
+    // whenever either changes
+    if (! juce::approximatelyEqual(a, lastA) || ! juce::approximatelyEqual(b, lastB)
+        || order != lastOrder)
+    {
+        lastA = a;
+        lastB = b;
+        lastOrder = order;
+        refreshCachedTerms(ad, bd);
+    }
+
+    if (order == 1)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = static_cast<SampleType>(processFirstOrder(static_cast<double>(data[i]), ad, bd));
+    }
+    else
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = static_cast<SampleType>(processSecondOrder(static_cast<double>(data[i]), ad, bd));
+    }
+}
+
+template void ValveShaper::ADAA::process<float>(float*, int, float, float);
+template void ValveShaper::ADAA::process<double>(double*, int, float, float);
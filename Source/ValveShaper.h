@@ -0,0 +1,229 @@
+#pragma once
+
+#include <juce_dsp/juce_dsp.h>
+
+// Asymmetric tanh waveshaper used by the valve stage.
+//
+// Two kernels are available. Exact evaluates std::tanh behind the x >= 0
+// branch. Fast selects the positive/negative gain with a SIMD mask and
+// replaces tanh with a clamped 13/6 rational approximation, several samples
+// per instruction. Both are written for float and double.
+struct ValveShaper
+{
+    enum class Kernel { Exact, Fast };
+
+    template <typename SampleType>
+    static SampleType exact(SampleType x, SampleType a, SampleType b);
+
+    // Forms the gain exactly as the SIMD lanes in process() do, so a sample
+    // shaped here matches one shaped in a vector bit for bit.
+    template <typename SampleType>
+    static SampleType fast(SampleType x, SampleType a, SampleType b);
+
+    // Rational tanh approximation, clamped to +-7.9053.
+    // Max absolute error against std::tanh is 4e-7 (about -128 dB) over the
+    // whole float range, and the output never leaves [-1, 1].
+    template <typename SampleType>
+    static SampleType fastTanh(SampleType x);
+
+    // Shapes numSamples values in place. The curve comes from Curve's static
+    // constexpr curvature and asymmetry, so a (1 + b) and a (1 - b) fold
+    // into constants. Kernel::Fast expects data to be SIMD-aligned (see
+    // getAlignedPointer).
+    template <typename Curve, typename SampleType>
+    static void process(Kernel kernel, SampleType* data, int numSamples);
+
+    // Scratch buffers handed to process() must reserve this many extra
+    // samples so getAlignedPointer can round their start up.
+    static constexpr int alignmentPadding = 16;
+
+    template <typename SampleType>
+    static SampleType* getAlignedPointer(SampleType* ptr);
+
+    // Closed-form antiderivatives of the shaper. Each half integrates to
+    // log(cosh(k x)) / k, where k = a (1 + b) for x >= 0 and a (1 - b) below.
+    // The second antiderivative uses a Bernoulli series for the dilogarithm.
+    static double antiderivative1(double x, double a, double b);
+    static double antiderivative2(double x, double a, double b);
+
+    // Antiderivative anti-aliasing of the same shaper, in double precision.
+    // First order adds half a sample of delay and second order a full
+    // sample, both at the rate it runs at.
+    struct ADAA
+    {
+        int order = 2;
+
+        void reset();
+
+        template <typename SampleType>
+        void process(SampleType* data, int numSamples, float a, float b);
+
+    private:
+        double x1 = 0.0, x2 = 0.0;
+        double ad1x1 = 0.0;   // F1(x1), first order
+        double ad2x1 = 0.0;   // F2(x1), second order
+        double d1x1 = 0.0;    // (F2(x1) - F2(x2)) / (x1 - x2), second order
+        float lastA = 0.0f, lastB = 0.0f;
+        int lastOrder = 0;
+
+        void refreshCachedTerms(double a, double b);
+        double processFirstOrder(double x0, double a, double b);
+        double processSecondOrder(double x0, double a, double b);
+    };
+
+    // Clamp point and coefficients of the 13/6 rational tanh fit
+    // (odd numerator in x, even denominator in x^2)
+    struct TanhFit
+    {
+        static constexpr float clamp = 7.90531110763549805f;
+
+        static constexpr float alpha1  =  4.89352455891786e-03f;
+        static constexpr float alpha3  =  6.37261928875436e-04f;
+        static constexpr float alpha5  =  1.48572235717979e-05f;
+        static constexpr float alpha7  =  5.12229709037114e-08f;
+        static constexpr float alpha9  = -8.60467152213735e-11f;
+        static constexpr float alpha11 =  2.00018790482477e-13f;
+        static constexpr float alpha13 = -2.76076847742355e-16f;
+
+        static constexpr float beta0 = 4.89352518554385e-03f;
+        static constexpr float beta2 = 2.26843463243900e-03f;
+        static constexpr float beta4 = 1.18534705686654e-04f;
+        static constexpr float beta6 = 1.19825839466702e-06f;
+    };
+};
+
+//==============================================================================
+// The kernels are templates so the valve stage can instantiate them per mode
+// and sample type with the curve known at compile time.
+
+template <typename SampleType>
+SampleType ValveShaper::exact(SampleType x, SampleType a, SampleType b)
+{
+    SampleType xp = x * (SampleType(1) + b);
+    SampleType xn = x * (SampleType(1) - b);
+
+    return (x >= SampleType(0))
+        ? std::tanh(a * xp)
+        : std::tanh(a * xn);
+}
+
+template <typename SampleType>
+SampleType ValveShaper::fastTanh(SampleType x)
+{
+    const auto c = [](float value) { return static_cast<SampleType>(value); };
+
+    x = juce::jlimit(-c(TanhFit::clamp), c(TanhFit::clamp), x);
+    const SampleType x2 = x * x;
+
+    SampleType p = x2 * c(TanhFit::alpha13) + c(TanhFit::alpha11);
+    p = p * x2 + c(TanhFit::alpha9);
+    p = p * x2 + c(TanhFit::alpha7);
+    p = p * x2 + c(TanhFit::alpha5);
+    p = p * x2 + c(TanhFit::alpha3);
+    p = p * x2 + c(TanhFit::alpha1);
+    p *= x;
+
+    SampleType q = x2 * c(TanhFit::beta6) + c(TanhFit::beta4);
+    q = q * x2 + c(TanhFit::beta2);
+    q = q * x2 + c(TanhFit::beta0);
+
+    return p / q;
+}
+
+template <typename SampleType>
+SampleType ValveShaper::fast(SampleType x, SampleType a, SampleType b)
+{
+    const SampleType negGain = a * (SampleType(1) - b);
+    const SampleType gainDelta = a * SampleType(2) * b;
+
+    // gain = a * (1 - b) + (x >= 0 ? 2ab : 0)
+    return fastTanh(x * (negGain + (x >= SampleType(0) ? gainDelta : SampleType(0))));
+}
+
+template <typename SampleType>
+SampleType* ValveShaper::getAlignedPointer(SampleType* ptr)
+{
+   #if JUCE_USE_SIMD
+    return juce::dsp::SIMDRegister<SampleType>::getNextSIMDAlignedPtr(ptr);
+   #else
+    return ptr;
+   #endif
+}
+
+template <typename Curve, typename SampleType>
+void ValveShaper::process(Kernel kernel, SampleType* data, int numSamples)
+{
+    constexpr auto a = static_cast<SampleType>(Curve::curvature);
+    constexpr auto b = static_cast<SampleType>(Curve::asymmetry);
+
+    if (kernel == Kernel::Exact)
+    {
+        for (int i = 0; i < numSamples; ++i)
+            data[i] = exact(data[i], a, b);
+        return;
+    }
+
+    int i = 0;
+
+   #if JUCE_USE_SIMD
+    using Vec = juce::dsp::SIMDRegister<SampleType>;
+    constexpr int width = static_cast<int>(Vec::SIMDNumElements);
+    constexpr int tileSize = 64;
+    const auto c = [](float value) { return Vec::expand(static_cast<SampleType>(value)); };
+
+    jassert(Vec::isSIMDAligned(data));
+
+    constexpr SampleType negGain = a * (SampleType(1) - b);
+    constexpr SampleType gainDelta = a * SampleType(2) * b;
+
+    const auto zero = Vec::expand(SampleType(0));
+    const auto hi = c(TanhFit::clamp);
+    const auto lo = c(-TanhFit::clamp);
+
+    // SIMDRegister has no divide, so each tile writes numerators in place and
+    // denominators to the stack, then a plain loop finishes p / q.
+    alignas(64) SampleType den[tileSize];
+
+    const int numVectorised = numSamples - numSamples % width;
+
+    while (i < numVectorised)
+    {
+        const int tileLength = juce::jmin(tileSize, numVectorised - i);
+        SampleType* tile = data + i;
+
+        for (int j = 0; j < tileLength; j += width)
+        {
+            auto x = Vec::fromRawArray(tile + j);
+
+            // gain = a * (1 - b) + (x >= 0 ? 2ab : 0)
+            const auto gain = Vec::expand(negGain) + (Vec::expand(gainDelta) & Vec::greaterThanOrEqual(x, zero));
+            x = Vec::max(lo, Vec::min(hi, x * gain));
+
+            const auto x2 = x * x;
+
+            auto p = Vec::multiplyAdd(c(TanhFit::alpha11), x2, c(TanhFit::alpha13));
+            p = Vec::multiplyAdd(c(TanhFit::alpha9), x2, p);
+            p = Vec::multiplyAdd(c(TanhFit::alpha7), x2, p);
+            p = Vec::multiplyAdd(c(TanhFit::alpha5), x2, p);
+            p = Vec::multiplyAdd(c(TanhFit::alpha3), x2, p);
+            p = Vec::multiplyAdd(c(TanhFit::alpha1), x2, p);
+            p *= x;
+
+            auto q = Vec::multiplyAdd(c(TanhFit::beta4), x2, c(TanhFit::beta6));
+            q = Vec::multiplyAdd(c(TanhFit::beta2), x2, q);
+            q = Vec::multiplyAdd(c(TanhFit::beta0), x2, q);
+
+            p.copyToRawArray(tile + j);
+            q.copyToRawArray(den + j);
+        }
+
+        for (int j = 0; j < tileLength; ++j)
+            tile[j] /= den[j];
+
+        i += tileLength;
+    }
+   #endif
+
+    for (; i < numSamples; ++i)
+        data[i] = fast(data[i], a, b);
+}
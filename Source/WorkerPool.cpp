@@ -0,0 +1,205 @@
+#include "WorkerPool.h"
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cerrno>
+#include <mutex>
+
+#if JUCE_WINDOWS
+ #include <windows.h>
+#elif JUCE_MAC || JUCE_IOS
+ #include <dispatch/dispatch.h>
+#endif
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+namespace
+{
+    // A short pause for a spinning thread, without giving up its time slice
+    inline void spinPause()
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #endif
+    }
+}
+
+//==============================================================================
+#if JUCE_WINDOWS
+WorkerPool::Semaphore::Semaphore()  : handle(CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr)) {}
+WorkerPool::Semaphore::~Semaphore() { CloseHandle(handle); }
+void WorkerPool::Semaphore::post()  { ReleaseSemaphore(handle, 1, nullptr); }
+void WorkerPool::Semaphore::wait()  { WaitForSingleObject(handle, INFINITE); }
+#elif JUCE_MAC || JUCE_IOS
+WorkerPool::Semaphore::Semaphore()  : handle(dispatch_semaphore_create(0)) {}
+WorkerPool::Semaphore::~Semaphore() { dispatch_release(static_cast<dispatch_semaphore_t>(handle)); }
+void WorkerPool::Semaphore::post()  { dispatch_semaphore_signal(static_cast<dispatch_semaphore_t>(handle)); }
+void WorkerPool::Semaphore::wait()  { dispatch_semaphore_wait(static_cast<dispatch_semaphore_t>(handle), DISPATCH_TIME_FOREVER); }
+#else
+WorkerPool::Semaphore::Semaphore()  { sem_init(&semaphore, 0, 0); }
+WorkerPool::Semaphore::~Semaphore() { sem_destroy(&semaphore); }
+void WorkerPool::Semaphore::post()  { sem_post(&semaphore); }
+
+void WorkerPool::Semaphore::wait()
+{
+    while (sem_wait(&semaphore) != 0 && errno == EINTR) {}
+}
+#endif
+
+//==============================================================================
+
+WorkerPool::WorkerPool(int numWorkers)
+{
+    for (int w = 0; w < numWorkers; ++w)
+        workers.push_back(std::make_unique<Worker>());
+
+    for (auto& worker : workers)
+        worker->thread = std::thread([this, w = worker.get()] { workerLoop(*w); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    stopping.store(true);
+
+    for (auto& worker : workers)
+    {
+        if (worker->sleeping.exchange(false))
+            worker->wake.post();
+
+        worker->thread.join();
+    }
+}
+
+std::shared_ptr<WorkerPool> WorkerPool::getShared()
+{
+    static std::mutex lock;
+    static std::weak_ptr<WorkerPool> shared;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    if (auto existing = shared.lock())
+        return existing;
+
+    const int numWorkers = juce::jmax(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    auto pool = std::make_shared<WorkerPool>(numWorkers);
+    shared = pool;
+    return pool;
+}
+
+void WorkerPool::runBatch(int numTasks, int maxHelpers, void* context, Invoker invoke)
+{
+    const bool owner = ! busy.exchange(true, std::memory_order_acquire);
+
+    const int helpers = owner && numTasks <= maxTasks
+                          ? juce::jmin(maxHelpers, getNumWorkers(), numTasks - 1) : 0;
+
+    if (helpers <= 0)
+    {
+        for (int index = 0; index < numTasks; ++index)
+            invoke(context, index);
+
+        if (owner)
+            busy.store(false, std::memory_order_release);
+
+        return;
+    }
+
+    // The batch is complete before the next one is published, so the
+    // fields below never change under a task that is still running. The
+    // task count travels in the claim word, so a worker still holding the
+    // previous word cannot claim past the end of its own batch.
+    ++generation;
+    batchContext.store(context, std::memory_order_relaxed);
+    batchInvoke.store(invoke, std::memory_order_relaxed);
+    pending.store(numTasks, std::memory_order_relaxed);
+    claim.store((static_cast<juce::uint64>(generation) << 32) | (static_cast<juce::uint64>(numTasks) << 16),
+                std::memory_order_release);
+
+    for (int w = 0; w < helpers; ++w)
+    {
+        auto& worker = *workers[static_cast<size_t>(w)];
+        worker.assigned.store(generation);
+
+        if (worker.sleeping.exchange(false))
+            worker.wake.post();
+    }
+
+    runTasks(generation);
+
+    // Yielding would be a system call; the last tasks are short
+    while (pending.load(std::memory_order_acquire) > 0)
+        spinPause();
+
+    busy.store(false, std::memory_order_release);
+}
+
+// Claims and runs tasks of the given batch until none are left. A worker
+// that arrives after its batch has moved on finds nothing to claim. A
+// successful claim leaves a task of the batch unfinished, so its caller is
+// still waiting and the context and invoker are still its own.
+void WorkerPool::runTasks(juce::uint32 batch)
+{
+    for (;;)
+    {
+        auto current = claim.load(std::memory_order_acquire);
+
+        if (static_cast<juce::uint32>(current >> 32) != batch)
+            return;
+
+        const auto numTasks = static_cast<int>((current >> 16) & 0xffffu);
+        const auto index = static_cast<int>(current & 0xffffu);
+
+        if (index >= numTasks)
+            return;
+
+        if (! claim.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel))
+            continue;
+
+        batchInvoke.load(std::memory_order_relaxed)(batchContext.load(std::memory_order_relaxed), index);
+        pending.fetch_sub(1, std::memory_order_acq_rel);
+    }
+}
+
+void WorkerPool::workerLoop(Worker& worker)
+{
+    juce::ScopedNoDenormals noDenormals;
+    juce::uint32 lastSeen = 0;
+
+    for (;;)
+    {
+        auto next = worker.assigned.load(std::memory_order_acquire);
+
+        for (int spin = 0; next == lastSeen && spin < spinCount && ! stopping.load(); ++spin)
+        {
+            std::this_thread::yield();
+            next = worker.assigned.load(std::memory_order_acquire);
+        }
+
+        // sleeping is raised before the last look at assigned and stopping,
+        // which runBatch() and the destructor store before clearing it. If
+        // they cleared it first, their post is on its way and is taken here,
+        // so a wake-up is never lost and none is left over.
+        if (next == lastSeen)
+        {
+            worker.sleeping.store(true);
+
+            if (stopping.load() || worker.assigned.load() != lastSeen)
+            {
+                if (! worker.sleeping.exchange(false))
+                    worker.wake.wait();
+            }
+            else
+            {
+                worker.wake.wait();
+            }
+
+            next = worker.assigned.load(std::memory_order_acquire);
+        }
+
+        if (stopping.load())
+            return;
+
+        lastSeen = next;
+        runTasks(next);
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <juce_core/juce_core.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#if ! (JUCE_WINDOWS || JUCE_MAC || JUCE_IOS)
+ #include <semaphore.h>
+#endif
+
+// Worker threads shared by every instance in the process, for running a
+// handful of independent tasks at once (the bands of a multiband block).
+//
+// run() publishes a batch through a lock-free claim counter, wakes only the
+// workers it asks for and claims tasks itself as well, so a batch never
+// waits on a worker that is slow to wake. After a batch, workers spin
+// briefly before sleeping, which keeps the handoff cheap when sub-blocks
+// follow each other closely. One batch runs at a time: a caller that finds
+// the pool busy runs its whole batch itself rather than waiting.
+//
+// The caller takes no lock and makes no blocking call: sleeping workers are
+// woken through a semaphore post, and the caller spins for the last tasks
+// without yielding. The pool is still meant for offline rendering only.
+// The caller's thread waits for the slowest helper, and a helper that is
+// descheduled stalls it, which a realtime deadline cannot absorb.
+class WorkerPool
+{
+public:
+    explicit WorkerPool(int numWorkers);
+    ~WorkerPool();
+
+    // The process-wide pool, with one worker per core besides the caller's.
+    // Created with the first user and stopped with the last.
+    static std::shared_ptr<WorkerPool> getShared();
+
+    int getNumWorkers() const { return static_cast<int>(workers.size()); }
+
+    // Calls task(index) for every index below numTasks, on the calling
+    // thread and up to maxHelpers workers, and returns once all have
+    // finished. Does not allocate or lock. Offline use only, see above.
+    template <typename Task>
+    void run(int numTasks, int maxHelpers, Task& task)
+    {
+        runBatch(numTasks, maxHelpers, &task,
+                 [](void* context, int index) { (*static_cast<Task*>(context))(index); });
+    }
+
+private:
+    using Invoker = void (*)(void*, int);
+
+    // Counting semaphore on the platform's primitive. post() takes no lock.
+    class Semaphore
+    {
+    public:
+        Semaphore();
+        ~Semaphore();
+
+        void post();
+        void wait();
+
+    private:
+       #if JUCE_WINDOWS || JUCE_MAC || JUCE_IOS
+        void* handle = nullptr;
+       #else
+        sem_t semaphore;
+       #endif
+
+        JUCE_DECLARE_NON_COPYABLE(Semaphore)
+    };
+
+    // Each worker sleeps on its own semaphore, so a batch wakes exactly the
+    // helpers it uses. Whoever clears sleeping owes the one post.
+    struct Worker
+    {
+        std::thread thread;
+        Semaphore wake;
+        std::atomic<juce::uint32> assigned { 0 };
+        std::atomic<bool> sleeping { false };
+    };
+
+    static constexpr int spinCount = 2000;
+
+    // Largest batch the workers share; a larger one runs on the caller
+    static constexpr int maxTasks = 0xffff;
+
+    void runBatch(int numTasks, int maxHelpers, void* context, Invoker invoke);
+    void runTasks(juce::uint32 batch);
+    void workerLoop(Worker& worker);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+
+    std::atomic<bool> busy { false };
+    juce::uint32 generation = 0;   // written only by the caller that set busy
+
+    // Batch number in the high half, then the batch's task count and the
+    // next unclaimed task in 16 bits each
+    std::atomic<juce::uint64> claim { 0 };
+    std::atomic<int> pending { 0 };
+    std::atomic<void*> batchContext { nullptr };
+    std::atomic<Invoker> batchInvoke { nullptr };
+    std::atomic<bool> stopping { false };
+
+    JUCE_DECLARE_NON_COPYABLE(WorkerPool)
+};
@@ -0,0 +1,670 @@
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+#include "SaturatorDSP.h"
+#include "StageTrace.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <vector>
+
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+// Headless benchmark for SaturatorDSPBase::process.
+//
+// Sweeps mode, quality, sample rate, channel count, block size and test
+// signal, and writes a JSON report with ns/sample, realtime factor and a
+// per-stage breakdown. With --baseline=<report.json> every case is compared
+// against an earlier run, and the exit code is non-zero when any case is
+// slower than the baseline by more than --max-regression.
+//
+// Each case also reports the time and heap bytes taken to prepare a second
+// instance while the measured one is alive, which is what a session with
+// many instances pays per insert.
+//
+// With --trace=<file.json> the breakdown pass of every case is also traced,
+// one track per case, and saved as Chrome trace JSON.
+
+namespace
+{
+    std::atomic<bool> countAllocations { false };
+    std::atomic<size_t> allocatedBytes { 0 };
+
+    void countAllocation(std::size_t size)
+    {
+        if (countAllocations.load(std::memory_order_relaxed))
+            allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    // Over-aligned allocations take the aligned overloads, so they are
+    // counted too
+    void* allocateAligned(std::size_t size, std::align_val_t alignment)
+    {
+        countAllocation(size);
+
+        const auto align = static_cast<std::size_t>(alignment);
+        const auto length = size > 0 ? size : 1;
+
+       #if JUCE_WINDOWS
+        if (auto* ptr = _aligned_malloc(length, align))
+            return ptr;
+       #else
+        void* ptr = nullptr;
+        if (posix_memalign(&ptr, juce::jmax(align, sizeof(void*)), length) == 0)
+            return ptr;
+       #endif
+
+        throw std::bad_alloc();
+    }
+
+    void freeAligned(void* ptr)
+    {
+       #if JUCE_WINDOWS
+        _aligned_free(ptr);
+       #else
+        std::free(ptr);
+       #endif
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    countAllocation(size);
+
+    if (auto* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t a)    { return allocateAligned(size, a); }
+void* operator new[](std::size_t size, std::align_val_t a)  { return allocateAligned(size, a); }
+
+void operator delete(void* ptr) noexcept               { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept  { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept                  { freeAligned(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept                { freeAligned(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept     { freeAligned(ptr); }
+void operator delete[](void* ptr, std::size_t, std::align_val_t) noexcept   { freeAligned(ptr); }
+
+namespace
+{
+    enum class Signal { Sine, Noise, Drums };
+
+    const char* getSignalName(Signal signal)
+    {
+        switch (signal)
+        {
+            case Signal::Sine:  return "sine";
+            case Signal::Noise: return "noise";
+            case Signal::Drums: return "drums";
+            default:            return "";
+        }
+    }
+
+    const char* getModeName(SaturatorDSPBase::Mode mode)
+    {
+        switch (mode)
+        {
+            case SaturatorDSPBase::Mode::Triode:  return "Triode";
+            case SaturatorDSPBase::Mode::Pentode: return "Pentode";
+            case SaturatorDSPBase::Mode::Torture: return "Torture";
+            default:                          return "";
+        }
+    }
+
+    const char* getQualityName(SaturatorDSPBase::Quality quality)
+    {
+        switch (quality)
+        {
+            case SaturatorDSPBase::Quality::Standard: return "Standard";
+            case SaturatorDSPBase::Quality::Live2x:   return "Live2x";
+            case SaturatorDSPBase::Quality::Live1x:   return "Live1x";
+            case SaturatorDSPBase::Quality::Fixed2x:  return "Fixed2x";
+            case SaturatorDSPBase::Quality::Fixed4x:  return "Fixed4x";
+            case SaturatorDSPBase::Quality::Fixed8x:  return "Fixed8x";
+            case SaturatorDSPBase::Quality::Fixed16x: return "Fixed16x";
+            default:                              return "";
+        }
+    }
+
+    const char* getFilterName(SaturatorDSPBase::Filter filter)
+    {
+        switch (filter)
+        {
+            case SaturatorDSPBase::Filter::PolyphaseIIR: return "iir";
+            case SaturatorDSPBase::Filter::HalfBandFIR:  return "fir";
+            default:                                  return "";
+        }
+    }
+
+    //==========================================================================
+    // Test signals
+    //==========================================================================
+
+    // Decaying envelope that restarts every period seconds, offset by phase
+    float hitEnvelope(double t, double period, double phase, double decay)
+    {
+        const double local = std::fmod(t + period - phase, period);
+        return static_cast<float>(std::exp(-local / decay));
+    }
+
+    // A rough drum-bus stand-in: pitched kick, noisy snare, hats and a bass
+    // line at 120 BPM, peaking around -3 dBFS
+    void fillDrums(float* dest, int numSamples, double sampleRate, juce::Random& random)
+    {
+        const double twoPi = juce::MathConstants<double>::twoPi;
+        double kickPhase = 0.0;
+        float previousNoise = 0.0f;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const double t = i / sampleRate;
+
+            const float kickEnv = hitEnvelope(t, 0.5, 0.0, 0.15);
+            kickPhase += twoPi * (45.0 + 75.0 * kickEnv * kickEnv) / sampleRate;
+            const float kick = kickEnv * static_cast<float>(std::sin(kickPhase));
+
+            const float noise = random.nextFloat() * 2.0f - 1.0f;
+            const float snare = hitEnvelope(t, 1.0, 0.5, 0.08)
+                              * (0.6f * noise + 0.4f * static_cast<float>(std::sin(twoPi * 180.0 * t)));
+            const float hat = hitEnvelope(t, 0.125, 0.0, 0.02) * 0.5f * (noise - previousNoise);
+            previousNoise = noise;
+
+            const float bass = 0.3f * static_cast<float>(std::sin(twoPi * 55.0 * t))
+                             * (0.5f + 0.5f * hitEnvelope(t, 2.0, 0.0, 0.6));
+
+            dest[i] = 0.45f * (kick + 0.6f * snare + 0.3f * hat + bass);
+        }
+    }
+
+    juce::AudioBuffer<float> makeSignal(Signal signal, double sampleRate, int numChannels, int numSamples)
+    {
+        juce::AudioBuffer<float> buffer(numChannels, numSamples);
+        const double twoPi = juce::MathConstants<double>::twoPi;
+
+        for (int ch = 0; ch < numChannels; ++ch)
+        {
+            juce::Random random(1234 + ch);
+            auto* data = buffer.getWritePointer(ch);
+
+            switch (signal)
+            {
+                case Signal::Sine:
+                    for (int i = 0; i < numSamples; ++i)
+                        data[i] = 0.5f * static_cast<float>(std::sin(twoPi * 1000.0 * i / sampleRate));
+                    break;
+
+                case Signal::Noise:
+                    for (int i = 0; i < numSamples; ++i)
+                        data[i] = 0.25f * (random.nextFloat() * 2.0f - 1.0f);
+                    break;
+
+                case Signal::Drums:
+                default:
+                    fillDrums(data, numSamples, sampleRate, random);
+                    break;
+            }
+        }
+
+        return buffer;
+    }
+
+    //==========================================================================
+    // Options
+    //==========================================================================
+
+    struct Options
+    {
+        juce::Array<SaturatorDSPBase::Mode> modes { SaturatorDSPBase::Mode::Triode,
+                                                SaturatorDSPBase::Mode::Pentode,
+                                                SaturatorDSPBase::Mode::Torture };
+        juce::Array<SaturatorDSPBase::Quality> qualities { SaturatorDSPBase::Quality::Standard };
+        juce::Array<double> sampleRates { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 };
+        juce::Array<int> channelCounts { 1, 2 };
+        juce::Array<int> blockSizes { 32, 64, 128, 256, 512, 1024, 2048, 4096 };
+        juce::Array<Signal> signals { Signal::Sine, Signal::Noise, Signal::Drums };
+        juce::Array<int> bandCounts { 1 };
+        juce::Array<int> threadCounts { 1 };
+
+        ValveShaper::Kernel kernel = ValveShaper::Kernel::Fast;
+        SaturatorDSPBase::Filter filter = SaturatorDSPBase::Filter::PolyphaseIIR;
+        int subBlockSize = SaturatorDSPBase::defaultSubBlockSize;
+        bool doublePrecision = false;
+        double seconds = 0.5;
+        juce::String outputPath;
+        juce::String baselinePath;
+        juce::String tracePath;
+        double maxRegression = 0.1;
+    };
+
+    juce::StringArray getList(const juce::ArgumentList& args, const juce::String& option)
+    {
+        return juce::StringArray::fromTokens(args.getValueForOption(option), ",", {});
+    }
+
+    Options parseOptions(const juce::ArgumentList& args)
+    {
+        Options options;
+
+        if (args.containsOption("--modes"))
+        {
+            options.modes.clear();
+            for (auto& name : getList(args, "--modes"))
+                for (int m = 0; m < 3; ++m)
+                    if (name.equalsIgnoreCase(getModeName(static_cast<SaturatorDSPBase::Mode>(m))))
+                        options.modes.add(static_cast<SaturatorDSPBase::Mode>(m));
+        }
+
+        if (args.containsOption("--qualities"))
+        {
+            options.qualities.clear();
+            for (auto& name : getList(args, "--qualities"))
+                for (int q = 0; q < SaturatorDSPBase::numQualities; ++q)
+                    if (name.equalsIgnoreCase(getQualityName(static_cast<SaturatorDSPBase::Quality>(q))))
+                        options.qualities.add(static_cast<SaturatorDSPBase::Quality>(q));
+        }
+
+        if (args.containsOption("--rates"))
+        {
+            options.sampleRates.clear();
+            for (auto& rate : getList(args, "--rates"))
+                options.sampleRates.add(rate.getDoubleValue());
+        }
+
+        if (args.containsOption("--channels"))
+        {
+            options.channelCounts.clear();
+            for (auto& count : getList(args, "--channels"))
+                options.channelCounts.add(juce::jlimit(1, SaturatorDSPBase::maxChannels, count.getIntValue()));
+        }
+
+        if (args.containsOption("--blocks"))
+        {
+            options.blockSizes.clear();
+            for (auto& size : getList(args, "--blocks"))
+                options.blockSizes.add(juce::jmax(1, size.getIntValue()));
+        }
+
+        if (args.containsOption("--signals"))
+        {
+            options.signals.clear();
+            for (auto& name : getList(args, "--signals"))
+                for (int s = 0; s < 3; ++s)
+                    if (name.equalsIgnoreCase(getSignalName(static_cast<Signal>(s))))
+                        options.signals.add(static_cast<Signal>(s));
+        }
+
+        if (args.containsOption("--bands"))
+        {
+            options.bandCounts.clear();
+            for (auto& count : getList(args, "--bands"))
+                options.bandCounts.add(juce::jlimit(1, SaturatorDSPBase::maxBands, count.getIntValue()));
+        }
+
+        if (args.containsOption("--threads"))
+        {
+            options.threadCounts.clear();
+            for (auto& count : getList(args, "--threads"))
+                options.threadCounts.add(juce::jlimit(1, SaturatorDSPBase::maxBands, count.getIntValue()));
+
+            // The serial case runs first, so the others can report their speedup
+            options.threadCounts.sort();
+        }
+
+        if (args.getValueForOption("--kernel").equalsIgnoreCase("exact"))
+            options.kernel = ValveShaper::Kernel::Exact;
+
+        if (args.getValueForOption("--filter").equalsIgnoreCase(getFilterName(SaturatorDSPBase::Filter::HalfBandFIR)))
+            options.filter = SaturatorDSPBase::Filter::HalfBandFIR;
+
+        if (args.containsOption("--sub-block"))
+            options.subBlockSize = juce::jlimit(SaturatorDSPBase::minSubBlockSize, SaturatorDSPBase::maxSubBlockSize,
+                                                args.getValueForOption("--sub-block").getIntValue());
+
+        options.doublePrecision = args.getValueForOption("--precision").equalsIgnoreCase("double");
+
+        if (args.containsOption("--seconds"))
+            options.seconds = juce::jmax(0.01, args.getValueForOption("--seconds").getDoubleValue());
+
+        if (args.containsOption("--max-regression"))
+            options.maxRegression = args.getValueForOption("--max-regression").getDoubleValue();
+
+        options.outputPath = args.getValueForOption("--output");
+        options.baselinePath = args.getValueForOption("--baseline");
+        options.tracePath = args.getValueForOption("--trace");
+        return options;
+    }
+
+    //==========================================================================
+    // Measurement
+    //==========================================================================
+
+    struct Case
+    {
+        SaturatorDSPBase::Mode mode;
+        SaturatorDSPBase::Quality quality;
+        SaturatorDSPBase::Filter filter;
+        double sampleRate;
+        int numChannels;
+        int blockSize;
+        Signal signal;
+        int numBands;
+        int numThreads;
+
+        juce::String getKey() const
+        {
+            // FIR, multiband and threaded cases get their own keys; full-band
+            // serial IIR keys match earlier reports
+            const juce::String filterSuffix = filter == SaturatorDSPBase::Filter::HalfBandFIR ? "-fir" : "";
+            const juce::String bandSuffix = numBands > 1 ? "/" + juce::String(numBands) + "band" : "";
+            const juce::String threadSuffix = numThreads > 1 ? "/" + juce::String(numThreads) + "thread" : "";
+
+            return juce::String(getModeName(mode)) + "/" + getQualityName(quality) + filterSuffix + "/"
+                 + juce::String(sampleRate, 0) + "/" + juce::String(numChannels) + "/"
+                 + juce::String(blockSize) + "/" + getSignalName(signal) + bandSuffix + threadSuffix;
+        }
+    };
+
+    // Streams the source through the DSP block by block and returns the
+    // ticks spent inside process() only. A trace is drained after each
+    // block, outside the timed region.
+    template <typename SampleType>
+    juce::int64 runPass(SaturatorDSP<SampleType>& dsp, const Case& c, const juce::AudioBuffer<SampleType>& source,
+                        juce::AudioBuffer<SampleType>& io, int numBlocks, StageTrace* trace = nullptr)
+    {
+        SaturatorDSPBase::Parameters params;
+        params.driveDb = 20.0f;
+        params.bias = 0.1f;
+        params.sagAmount = 0.15f;
+        params.mix = 1.0f;
+
+        // Every band on, so none is skipped
+        params.numBands = c.numBands;
+        for (auto& band : params.bands)
+        {
+            band.driveDb = 20.0f;
+            band.bias = 0.1f;
+            band.sagAmount = 0.15f;
+        }
+
+        const int sourceLength = source.getNumSamples();
+        juce::int64 ticks = 0;
+        int readPos = 0;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            if (readPos + c.blockSize > sourceLength)
+                readPos = 0;
+
+            for (int ch = 0; ch < c.numChannels; ++ch)
+                io.copyFrom(ch, 0, source, ch, readPos, c.blockSize);
+
+            readPos += c.blockSize;
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            dsp.process(io, params, c.mode, { c.quality, c.filter });
+            ticks += juce::Time::getHighResolutionTicks() - start;
+
+            if (trace != nullptr)
+                trace->collect();
+        }
+
+        return ticks;
+    }
+
+    // Prepares another instance next to the measured one and returns the
+    // ticks and heap bytes that took
+    template <typename SampleType>
+    std::pair<juce::int64, size_t> measurePrepare(const Case& c, const Options& options)
+    {
+        SaturatorDSP<SampleType> dsp;
+        dsp.setShaperKernel(options.kernel);
+        dsp.setQualitiesInUse({ { c.quality, c.filter } }, c.numBands);
+        dsp.setSubBlockSize(options.subBlockSize);
+        dsp.setThreadCount(c.numThreads);
+
+        allocatedBytes = 0;
+        countAllocations = true;
+        const auto start = juce::Time::getHighResolutionTicks();
+        dsp.prepare(c.sampleRate, c.blockSize, c.numChannels);
+        const auto ticks = juce::Time::getHighResolutionTicks() - start;
+        countAllocations = false;
+
+        return { ticks, allocatedBytes.load() };
+    }
+
+    template <typename SampleType>
+    juce::var runCase(const Case& c, const Options& options, const juce::AudioBuffer<float>& signal,
+                      StageTrace* trace)
+    {
+        const double ticksPerSecond = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+
+        SaturatorDSP<SampleType> dsp;
+        dsp.setShaperKernel(options.kernel);
+        dsp.setQualitiesInUse({ { c.quality, c.filter } }, c.numBands);
+        dsp.setSubBlockSize(options.subBlockSize);
+        dsp.setThreadCount(c.numThreads);
+        dsp.prepare(c.sampleRate, c.blockSize, c.numChannels);
+
+        juce::AudioBuffer<SampleType> source;
+        source.makeCopyOf(signal);
+
+        juce::AudioBuffer<SampleType> io(c.numChannels, c.blockSize);
+
+        const int numBlocks = juce::jmax(1, static_cast<int>(options.seconds * c.sampleRate) / c.blockSize);
+        const int warmupBlocks = juce::jmax(1, numBlocks / 5);
+
+        runPass(dsp, c, source, io, warmupBlocks);
+        const auto ticks = runPass(dsp, c, source, io, numBlocks);
+
+        const double processedSamples = static_cast<double>(numBlocks) * c.blockSize;
+        const double seconds = static_cast<double>(ticks) / ticksPerSecond;
+        const double nsPerSample = 1.0e9 * seconds / (processedSamples * c.numChannels);
+
+        // Separate pass for the breakdown, so lap overhead stays out of the totals
+        SaturatorDSPBase::StageProfile profile;
+        dsp.setStageProfile(&profile);
+        dsp.setStageTrace(trace);
+        runPass(dsp, c, source, io, numBlocks, trace);
+        dsp.setStageProfile(nullptr);
+        dsp.setStageTrace(nullptr);
+
+        const auto [prepareTicks, prepareBytes] = measurePrepare<SampleType>(c, options);
+
+        auto* stages = new juce::DynamicObject();
+        for (int s = 0; s < static_cast<int>(SaturatorDSPBase::Stage::numStages); ++s)
+        {
+            const double stageSeconds = static_cast<double>(profile.ticks[static_cast<size_t>(s)]) / ticksPerSecond;
+            stages->setProperty(SaturatorDSPBase::getStageName(static_cast<SaturatorDSPBase::Stage>(s)),
+                                1.0e9 * stageSeconds / (processedSamples * c.numChannels));
+        }
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("key", c.getKey());
+        result->setProperty("mode", getModeName(c.mode));
+        result->setProperty("quality", getQualityName(c.quality));
+        result->setProperty("filter", getFilterName(c.filter));
+        result->setProperty("sampleRate", c.sampleRate);
+        result->setProperty("channels", c.numChannels);
+        result->setProperty("blockSize", c.blockSize);
+        result->setProperty("signal", getSignalName(c.signal));
+        result->setProperty("bands", c.numBands);
+        result->setProperty("threads", c.numThreads);
+        result->setProperty("nsPerSample", nsPerSample);
+        result->setProperty("realtimeFactor", (processedSamples / c.sampleRate) / seconds);
+        result->setProperty("stageNsPerSample", juce::var(stages));
+        result->setProperty("prepareMicroseconds", 1.0e6 * static_cast<double>(prepareTicks) / ticksPerSecond);
+        result->setProperty("prepareBytes", static_cast<juce::int64>(prepareBytes));
+        return juce::var(result);
+    }
+
+    // Adds baseline figures to each matching result; returns false if any
+    // case regressed by more than the allowed fraction
+    bool compareWithBaseline(juce::Array<juce::var>& results, const juce::var& baseline, double maxRegression)
+    {
+        std::map<juce::String, double> baselineTimes;
+        if (auto* baselineResults = baseline["results"].getArray())
+            for (auto& r : *baselineResults)
+                baselineTimes[r["key"].toString()] = static_cast<double>(r["nsPerSample"]);
+
+        bool passed = true;
+
+        for (auto& r : results)
+        {
+            auto it = baselineTimes.find(r["key"].toString());
+            if (it == baselineTimes.end() || it->second <= 0.0)
+                continue;
+
+            const double current = static_cast<double>(r["nsPerSample"]);
+            const double speedup = it->second / current;
+
+            if (auto* object = r.getDynamicObject())
+            {
+                object->setProperty("baselineNsPerSample", it->second);
+                object->setProperty("speedup", speedup);
+            }
+
+            if (current > it->second * (1.0 + maxRegression))
+            {
+                std::cerr << "REGRESSION " << r["key"].toString() << ": "
+                          << it->second << " -> " << current << " ns/sample" << std::endl;
+                passed = false;
+            }
+        }
+
+        return passed;
+    }
+
+    void printUsage()
+    {
+        std::cout << "saturator-benchmark [options]\n"
+                     "  --modes=Triode,Pentode,Torture\n"
+                     "  --qualities=Standard,Live2x,Live1x,Fixed2x,Fixed4x,Fixed8x,Fixed16x\n"
+                     "  --filter=iir|fir         oversampling filter (default iir)\n"
+                     "  --rates=44100,48000,88200,96000,176400,192000\n"
+                     "  --channels=1,2          up to 12\n"
+                     "  --blocks=32,64,128,256,512,1024,2048,4096\n"
+                     "  --signals=sine,noise,drums\n"
+                     "  --bands=1,2,3            multiband splits to run (default 1)\n"
+                     "  --threads=1,2,3          threads per multiband block (default 1)\n"
+                     "  --kernel=fast|exact      valve shaper kernel (default fast)\n"
+                     "  --precision=float|double sample type to process (default float)\n"
+                     "  --sub-block=128          samples the chain runs at once (32..1024)\n"
+                     "  --seconds=0.5            audio processed per case\n"
+                     "  --output=<file.json>     write the report there instead of stdout\n"
+                     "  --baseline=<file.json>   compare against an earlier report\n"
+                     "  --max-regression=0.1     allowed slowdown before failing\n"
+                     "  --trace=<file.json>      write a Chrome trace of the breakdown passes\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    juce::ScopedNoDenormals noDenormals;
+    const auto options = parseOptions(args);
+
+    juce::Array<juce::var> results;
+    std::vector<std::unique_ptr<StageTrace>> traces;
+
+    for (auto sampleRate : options.sampleRates)
+    {
+        for (auto numChannels : options.channelCounts)
+        {
+            for (auto signal : options.signals)
+            {
+                const int length = static_cast<int>(sampleRate * juce::jmin(options.seconds, 2.0));
+                const auto source = makeSignal(signal, sampleRate, numChannels, juce::jmax(length, 4096));
+
+                for (auto mode : options.modes)
+                {
+                    for (auto quality : options.qualities)
+                    {
+                        for (auto blockSize : options.blockSizes)
+                        {
+                            for (auto numBands : options.bandCounts)
+                            {
+                                double serialNsPerSample = 0.0;
+
+                                for (auto numThreads : options.threadCounts)
+                                {
+                                    const Case c { mode, quality, options.filter, sampleRate, numChannels, blockSize,
+                                                   signal, numBands, numThreads };
+                                    std::cerr << c.getKey() << std::endl;
+
+                                    // Drained after every block, so the ring holds one block of events
+                                    StageTrace* trace = nullptr;
+                                    if (options.tracePath.isNotEmpty())
+                                        trace = traces.emplace_back(std::make_unique<StageTrace>(c.getKey(), 1 << 12)).get();
+
+                                    auto result = options.doublePrecision ? runCase<double>(c, options, source, trace)
+                                                                          : runCase<float>(c, options, source, trace);
+                                    const double nsPerSample = static_cast<double>(result["nsPerSample"]);
+
+                                    if (numThreads == 1)
+                                        serialNsPerSample = nsPerSample;
+                                    else if (serialNsPerSample > 0.0)
+                                        if (auto* object = result.getDynamicObject())
+                                            object->setProperty("threadSpeedup", serialNsPerSample / nsPerSample);
+
+                                    results.add(result);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    bool passed = true;
+
+    if (options.baselinePath.isNotEmpty())
+    {
+        const auto baselineFile = juce::File::getCurrentWorkingDirectory().getChildFile(options.baselinePath);
+        passed = compareWithBaseline(results, juce::JSON::parse(baselineFile.loadFileAsString()),
+                                     options.maxRegression);
+    }
+
+    if (options.tracePath.isNotEmpty())
+    {
+        std::vector<const StageTrace*> tracesToWrite;
+        for (auto& trace : traces)
+            tracesToWrite.push_back(trace.get());
+
+        const auto traceFile = juce::File::getCurrentWorkingDirectory().getChildFile(options.tracePath);
+        if (! StageTrace::writeChromeTrace(traceFile, tracesToWrite))
+        {
+            std::cerr << "Could not write " << traceFile.getFullPathName() << std::endl;
+            passed = false;
+        }
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("kernel", options.kernel == ValveShaper::Kernel::Fast ? "fast" : "exact");
+    report->setProperty("subBlockSize", options.subBlockSize);
+    report->setProperty("precision", options.doublePrecision ? "double" : "float");
+    report->setProperty("seconds", options.seconds);
+    report->setProperty("results", results);
+
+    const auto json = juce::JSON::toString(juce::var(report));
+
+    if (options.outputPath.isNotEmpty())
+        juce::File::getCurrentWorkingDirectory().getChildFile(options.outputPath).replaceWithText(json);
+    else
+        std::cout << json << std::endl;
+
+    return passed ? 0 : 1;
+}
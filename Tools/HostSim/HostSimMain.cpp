@@ -0,0 +1,557 @@
+#include <juce_core/juce_core.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "PluginProcessor.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <thread>
+
+// Host simulation for many SaturatorProcessor instances at once.
+//
+// Plays the part of a DAW's audio engine. N processors run in host cycles
+// of one buffer each. Worker threads claim instances from a shared counter
+// until the cycle is done, as a host spreads independent tracks over its
+// worker threads. Callbacks are split into sub-blocks at random points.
+// Random parameters from the full APVTS list are automated between them.
+// The main thread, standing in for the message thread, restores saved
+// states into random instances while the cycles run.
+//
+// For each instance count and thread count it reports, as JSON:
+// - deadline misses, i.e. cycles that took longer than the buffer's duration
+// - p50/p99/p99.9 of cycle time and of single instance callbacks
+// - throughput in realtime instances, with its scaling over the thread
+//   counts
+// - the heap bytes each instance takes to construct and prepare
+//
+// Per-callback time rising with the thread count points at contention or
+// shared cache and memory bandwidth. Rising with the instance count at a
+// fixed thread count points at the per-instance working set.
+
+namespace
+{
+    std::atomic<bool> countAllocations { false };
+    std::atomic<size_t> allocatedBytes { 0 };
+}
+
+void* operator new(std::size_t size)
+{
+    if (countAllocations.load(std::memory_order_relaxed))
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+
+    if (auto* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept               { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept  { std::free(ptr); }
+
+namespace
+{
+    //==========================================================================
+    // Options
+    //==========================================================================
+
+    struct Options
+    {
+        juce::Array<int> instanceCounts { 16, 64, 256 };
+        juce::Array<int> threadCounts;
+        double sampleRate = 48000.0;
+        int bufferSize = 256;
+        int numChannels = 2;
+        double seconds = 5.0;           // audio per run
+        int quality = 0;                // Standard
+        int numBands = 1;
+        bool doublePrecision = false;
+        bool paced = false;             // wait for each buffer's start time
+        float splitChance = 0.3f;       // callbacks split into sub-blocks
+        float automationChance = 0.2f;  // callbacks with automation
+        double stateInterval = 0.05;    // seconds between state restores
+        juce::int64 seed = 1;
+        juce::String outputPath;
+    };
+
+    juce::StringArray getList(const juce::ArgumentList& args, const juce::String& option)
+    {
+        return juce::StringArray::fromTokens(args.getValueForOption(option), ",", {});
+    }
+
+    Options parseOptions(const juce::ArgumentList& args)
+    {
+        Options options;
+
+        if (args.containsOption("--instances"))
+        {
+            options.instanceCounts.clear();
+            for (auto& count : getList(args, "--instances"))
+                options.instanceCounts.add(juce::jmax(1, count.getIntValue()));
+        }
+
+        if (args.containsOption("--threads"))
+        {
+            for (auto& count : getList(args, "--threads"))
+                options.threadCounts.add(juce::jmax(1, count.getIntValue()));
+        }
+        else
+        {
+            // 1, 2, 4 ... up to every core
+            const int numCpus = juce::SystemStats::getNumCpus();
+            for (int t = 1; t < numCpus; t *= 2)
+                options.threadCounts.add(t);
+            options.threadCounts.add(numCpus);
+        }
+
+        // The first thread count is the reference for scaling
+        options.threadCounts.sort();
+
+        if (args.containsOption("--rate"))
+            options.sampleRate = juce::jlimit(22050.0, 384000.0, args.getValueForOption("--rate").getDoubleValue());
+
+        if (args.containsOption("--buffer"))
+            options.bufferSize = juce::jlimit(16, 8192, args.getValueForOption("--buffer").getIntValue());
+
+        if (args.containsOption("--channels"))
+            options.numChannels = juce::jlimit(1, SaturatorDSPBase::maxChannels, args.getValueForOption("--channels").getIntValue());
+
+        if (args.containsOption("--seconds"))
+            options.seconds = juce::jmax(0.1, args.getValueForOption("--seconds").getDoubleValue());
+
+        if (args.containsOption("--quality"))
+            options.quality = juce::jlimit(0, SaturatorDSPBase::numQualities - 1, args.getValueForOption("--quality").getIntValue());
+
+        if (args.containsOption("--bands"))
+            options.numBands = juce::jlimit(1, SaturatorDSPBase::maxBands, args.getValueForOption("--bands").getIntValue());
+
+        if (args.containsOption("--split"))
+            options.splitChance = juce::jlimit(0.0f, 1.0f, args.getValueForOption("--split").getFloatValue());
+
+        if (args.containsOption("--automation"))
+            options.automationChance = juce::jlimit(0.0f, 1.0f, args.getValueForOption("--automation").getFloatValue());
+
+        if (args.containsOption("--state-interval"))
+            options.stateInterval = args.getValueForOption("--state-interval").getDoubleValue();
+
+        if (args.containsOption("--seed"))
+            options.seed = args.getValueForOption("--seed").getLargeIntValue();
+
+        options.doublePrecision = args.getValueForOption("--precision").equalsIgnoreCase("double");
+        options.paced = args.containsOption("--paced");
+        options.outputPath = args.getValueForOption("--output");
+        return options;
+    }
+
+    //==========================================================================
+    // Instances
+    //==========================================================================
+
+    // One plugin instance with the host-side buffers of its track
+    struct Instance
+    {
+        std::unique_ptr<SaturatorProcessor> processor;
+        juce::AudioBuffer<float> floatBuffer;
+        juce::AudioBuffer<double> doubleBuffer;
+        juce::MidiBuffer midi;
+        juce::Random random;
+        int readPosition = 0;
+    };
+
+    void setParameter(SaturatorProcessor& processor, const char* id, float value)
+    {
+        auto* param = processor.getAPVTS().getParameter(id);
+        param->setValueNotifyingHost(param->convertTo0to1(value));
+    }
+
+    // Constructs and prepares n instances with random settings. Returns the
+    // heap bytes that took per instance: constructing, then preparing.
+    std::pair<size_t, size_t> createInstances(std::vector<Instance>& instances, int n, const Options& options)
+    {
+        juce::Random random(options.seed);
+        size_t constructBytes = 0, prepareBytes = 0;
+
+        juce::AudioProcessor::BusesLayout layout;
+        layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(options.numChannels));
+        layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(options.numChannels));
+
+        instances.resize(static_cast<size_t>(n));
+
+        for (auto& instance : instances)
+        {
+            allocatedBytes = 0;
+            countAllocations = true;
+            instance.processor = std::make_unique<SaturatorProcessor>();
+            countAllocations = false;
+            constructBytes += allocatedBytes.load();
+
+            auto& processor = *instance.processor;
+            processor.setBusesLayout(layout);
+            processor.setProcessingPrecision(options.doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                                     : juce::AudioProcessor::singlePrecision);
+
+            setParameter(processor, "mode", static_cast<float>(random.nextInt(3)));
+            setParameter(processor, "quality", static_cast<float>(options.quality));
+            setParameter(processor, "bands", static_cast<float>(options.numBands - 1));
+            setParameter(processor, "drive", 5.0f + 40.0f * random.nextFloat());
+            setParameter(processor, "bias", 0.4f * random.nextFloat() - 0.2f);
+            setParameter(processor, "mix", 50.0f + 50.0f * random.nextFloat());
+
+            allocatedBytes = 0;
+            countAllocations = true;
+            processor.setRateAndBufferSizeDetails(options.sampleRate, options.bufferSize);
+            processor.prepareToPlay(options.sampleRate, options.bufferSize);
+            countAllocations = false;
+            prepareBytes += allocatedBytes.load();
+
+            instance.floatBuffer.setSize(options.numChannels, options.bufferSize);
+            instance.doubleBuffer.setSize(options.numChannels, options.bufferSize);
+            instance.random.setSeed(random.nextInt64());
+        }
+
+        return { constructBytes / static_cast<size_t>(n), prepareBytes / static_cast<size_t>(n) };
+    }
+
+    // A few seconds of drum-like material every instance reads from at its
+    // own offset, so the shaper, sag and silence detection see real work
+    juce::AudioBuffer<float> makeSource(double sampleRate)
+    {
+        const int length = static_cast<int>(sampleRate * 2.0);
+        juce::AudioBuffer<float> source(1, length);
+        juce::Random random(1234);
+        auto* data = source.getWritePointer(0);
+
+        const double twoPi = juce::MathConstants<double>::twoPi;
+        for (int i = 0; i < length; ++i)
+        {
+            const double t = i / sampleRate;
+            const double beat = std::fmod(t, 0.25);
+            const float hit = static_cast<float>(std::exp(-beat / 0.05));
+            data[i] = 0.4f * hit * (0.5f * static_cast<float>(std::sin(twoPi * 80.0 * t)) + 0.5f * (2.0f * random.nextFloat() - 1.0f))
+                    + 0.1f * static_cast<float>(std::sin(twoPi * 220.0 * t));
+        }
+
+        return source;
+    }
+
+    //==========================================================================
+    // Host cycle
+    //==========================================================================
+
+    // Sets a few random parameters, chosen from every parameter the
+    // processor exposes, to random values
+    void automate(Instance& instance)
+    {
+        const auto& params = instance.processor->getParameters();
+        const int count = 1 + instance.random.nextInt(3);
+
+        for (int i = 0; i < count; ++i)
+            params[instance.random.nextInt(params.size())]->setValueNotifyingHost(instance.random.nextFloat());
+    }
+
+    // One track's callback: copy the input, then processBlock in sub-blocks
+    // split at random points, with automation between them. Returns the
+    // ticks spent in processBlock.
+    template <typename SampleType>
+    juce::int64 runCallback(Instance& instance, juce::AudioBuffer<SampleType>& buffer,
+                            const juce::AudioBuffer<float>& source, const Options& options)
+    {
+        const int total = options.bufferSize;
+
+        for (int ch = 0; ch < options.numChannels; ++ch)
+        {
+            const auto* in = source.getReadPointer(0, instance.readPosition);
+            auto* out = buffer.getWritePointer(ch);
+            for (int i = 0; i < total; ++i)
+                out[i] = static_cast<SampleType>(in[i]);
+        }
+
+        instance.readPosition += total;
+        if (instance.readPosition + total > source.getNumSamples())
+            instance.readPosition = 0;
+
+        juce::int64 ticks = 0;
+        int position = 0;
+
+        while (position < total)
+        {
+            int n = total - position;
+            if (n > 1 && instance.random.nextFloat() < options.splitChance)
+                n = 1 + instance.random.nextInt(n - 1);
+
+            if (instance.random.nextFloat() < options.automationChance)
+                automate(instance);
+
+            juce::AudioBuffer<SampleType> block(buffer.getArrayOfWritePointers(), options.numChannels, position, n);
+
+            const auto start = juce::Time::getHighResolutionTicks();
+            instance.processor->processBlock(block, instance.midi);
+            ticks += juce::Time::getHighResolutionTicks() - start;
+
+            position += n;
+        }
+
+        return ticks;
+    }
+
+    struct RunResult
+    {
+        std::vector<double> cycleSeconds;
+        std::vector<double> callbackSeconds;
+        double wallSeconds = 0.0;
+        int statesRestored = 0;
+    };
+
+    // Runs the host cycles on numThreads workers while this thread restores
+    // states into random instances
+    RunResult runCycles(std::vector<Instance>& instances, int numThreads, const Options& options,
+                        const juce::AudioBuffer<float>& source, const std::vector<juce::MemoryBlock>& states)
+    {
+        const double ticksPerSecond = static_cast<double>(juce::Time::getHighResolutionTicksPerSecond());
+        const double period = options.bufferSize / options.sampleRate;
+        const int numCycles = juce::jmax(1, static_cast<int>(options.seconds / period));
+        const int numInstances = static_cast<int>(instances.size());
+
+        RunResult result;
+        result.cycleSeconds.resize(static_cast<size_t>(numCycles));
+
+        // The worker that finishes a cycle's last instance records it and
+        // opens the next one. A worker may claim an instance just after the
+        // next cycle opened; it then simply works on that cycle.
+        std::atomic<int> cycle { 0 };
+        std::atomic<int> nextInstance { 0 };
+        std::atomic<int> pending { numInstances };
+        std::atomic<juce::int64> cycleStart { 0 };
+
+        std::vector<std::vector<double>> callbackTimes(static_cast<size_t>(numThreads));
+        for (auto& times : callbackTimes)
+            times.reserve(static_cast<size_t>(numCycles * numInstances / numThreads + numInstances));
+
+        const auto runStart = juce::Time::getHighResolutionTicks();
+        cycleStart = runStart;
+
+        auto worker = [&](int w)
+        {
+            auto& times = callbackTimes[static_cast<size_t>(w)];
+
+            for (int c; (c = cycle.load(std::memory_order_acquire)) < numCycles;)
+            {
+                const int i = nextInstance.fetch_add(1, std::memory_order_acq_rel);
+
+                if (i >= numInstances)
+                {
+                    // All claimed: wait for the cycle to close
+                    for (int spins = 0; cycle.load(std::memory_order_acquire) == c; ++spins)
+                        if (spins > 64)
+                            std::this_thread::yield();
+
+                    continue;
+                }
+
+                auto& instance = instances[static_cast<size_t>(i)];
+                const auto ticks = options.doublePrecision
+                                     ? runCallback(instance, instance.doubleBuffer, source, options)
+                                     : runCallback(instance, instance.floatBuffer, source, options);
+                times.push_back(static_cast<double>(ticks) / ticksPerSecond);
+
+                if (pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                    continue;
+
+                // Last instance of the cycle, which cannot have moved on
+                const int finished = cycle.load(std::memory_order_relaxed);
+                const auto now = juce::Time::getHighResolutionTicks();
+                result.cycleSeconds[static_cast<size_t>(finished)] = static_cast<double>(now - cycleStart.load()) / ticksPerSecond;
+
+                // Paced: the next cycle starts at its buffer's time, unless
+                // this one ran late
+                auto nextStart = now;
+                if (options.paced)
+                {
+                    const auto due = runStart + static_cast<juce::int64>((finished + 1) * period * ticksPerSecond);
+                    while (juce::Time::getHighResolutionTicks() < due)
+                        std::this_thread::yield();
+                    nextStart = juce::jmax(now, due);
+                }
+
+                cycleStart = nextStart;
+                pending.store(numInstances, std::memory_order_relaxed);
+
+                // After the last cycle nothing is left to claim
+                if (finished + 1 < numCycles)
+                    nextInstance.store(0, std::memory_order_relaxed);
+
+                cycle.store(finished + 1, std::memory_order_release);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (int w = 0; w < numThreads; ++w)
+            threads.emplace_back(worker, w);
+
+        // Message thread: restore saved states into random instances, as
+        // preset loads and undo do during playback
+        juce::Random random(options.seed + 1);
+        while (cycle.load() < numCycles)
+        {
+            if (options.stateInterval > 0.0 && ! states.empty())
+            {
+                auto& instance = instances[static_cast<size_t>(random.nextInt(numInstances))];
+                const auto& state = states[static_cast<size_t>(random.nextInt(static_cast<int>(states.size())))];
+                instance.processor->setStateInformation(state.getData(), static_cast<int>(state.getSize()));
+                ++result.statesRestored;
+                juce::Thread::sleep(juce::jmax(1, juce::roundToInt(options.stateInterval * 1000.0)));
+            }
+            else
+            {
+                juce::Thread::sleep(5);
+            }
+        }
+
+        for (auto& t : threads)
+            t.join();
+
+        result.wallSeconds = static_cast<double>(juce::Time::getHighResolutionTicks() - runStart) / ticksPerSecond;
+
+        for (auto& times : callbackTimes)
+            result.callbackSeconds.insert(result.callbackSeconds.end(), times.begin(), times.end());
+
+        return result;
+    }
+
+    //==========================================================================
+    // Report
+    //==========================================================================
+
+    double percentile(std::vector<double>& values, double p)
+    {
+        if (values.empty())
+            return 0.0;
+
+        const auto index = static_cast<size_t>(juce::jmin(static_cast<double>(values.size() - 1),
+                                                          p * static_cast<double>(values.size())));
+        std::nth_element(values.begin(), values.begin() + static_cast<std::ptrdiff_t>(index), values.end());
+        return values[index];
+    }
+
+    juce::var makeDistribution(std::vector<double> values, double scale)
+    {
+        auto* object = new juce::DynamicObject();
+        object->setProperty("p50", scale * percentile(values, 0.5));
+        object->setProperty("p99", scale * percentile(values, 0.99));
+        object->setProperty("p999", scale * percentile(values, 0.999));
+        object->setProperty("max", values.empty() ? 0.0 : scale * *std::max_element(values.begin(), values.end()));
+        return juce::var(object);
+    }
+
+    void printUsage()
+    {
+        std::cout << "saturator-host-sim [options]\n"
+                     "  --instances=16,64,256    plugin instances per run\n"
+                     "  --threads=1,2,4          worker threads (default 1, 2, 4 ... up to the core count)\n"
+                     "  --rate=48000             sample rate\n"
+                     "  --buffer=256             host buffer size; one buffer per cycle\n"
+                     "  --channels=2             channels per instance\n"
+                     "  --seconds=5              audio per run\n"
+                     "  --quality=0              quality index (0 Standard ... 6 16x)\n"
+                     "  --bands=1                multiband split of every instance\n"
+                     "  --precision=float|double\n"
+                     "  --split=0.3              chance a callback is split into sub-blocks\n"
+                     "  --automation=0.2         chance a sub-block is preceded by automation\n"
+                     "  --state-interval=0.05    seconds between state restores (0 = none)\n"
+                     "  --paced                  start each cycle at its buffer's time, as a live host does\n"
+                     "  --seed=1\n"
+                     "  --output=<file.json>     write the report there instead of stdout\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    const auto options = parseOptions(args);
+
+    // The processors' parameter trees run timers, so they are made and
+    // destroyed on the message thread
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    const auto source = makeSource(options.sampleRate);
+    const double period = options.bufferSize / options.sampleRate;
+
+    juce::Array<juce::var> results;
+
+    for (auto numInstances : options.instanceCounts)
+    {
+        double referenceThroughput = 0.0;
+        int referenceThreads = 0;
+
+        for (auto numThreads : options.threadCounts)
+        {
+            std::cerr << numInstances << " instances, " << numThreads << " threads" << std::endl;
+
+            std::vector<Instance> instances;
+            const auto [constructBytes, prepareBytes] = createInstances(instances, numInstances, options);
+
+            // States to restore, saved from a few of the instances
+            std::vector<juce::MemoryBlock> states(static_cast<size_t>(juce::jmin(8, numInstances)));
+            for (size_t s = 0; s < states.size(); ++s)
+                instances[s].processor->getStateInformation(states[s]);
+
+            auto run = runCycles(instances, numThreads, options, source, states);
+
+            const double audioSeconds = static_cast<double>(run.cycleSeconds.size()) * period;
+            const double throughput = numInstances * audioSeconds / run.wallSeconds;
+
+            if (referenceThreads == 0)
+            {
+                referenceThroughput = throughput;
+                referenceThreads = numThreads;
+            }
+
+            const auto misses = std::count_if(run.cycleSeconds.begin(), run.cycleSeconds.end(),
+                                              [period](double s) { return s > period; });
+
+            auto* result = new juce::DynamicObject();
+            result->setProperty("instances", numInstances);
+            result->setProperty("threads", numThreads);
+            result->setProperty("cycles", static_cast<int>(run.cycleSeconds.size()));
+            result->setProperty("deadlineMisses", static_cast<int>(misses));
+            result->setProperty("missRate", static_cast<double>(misses) / static_cast<double>(run.cycleSeconds.size()));
+            result->setProperty("cycleMs", makeDistribution(run.cycleSeconds, 1.0e3));
+            result->setProperty("callbackUs", makeDistribution(run.callbackSeconds, 1.0e6));
+            result->setProperty("realtimeInstances", throughput);
+            result->setProperty("scaling", throughput / referenceThroughput);
+            result->setProperty("efficiency", (throughput / referenceThroughput) * referenceThreads / numThreads);
+            result->setProperty("constructBytesPerInstance", static_cast<juce::int64>(constructBytes));
+            result->setProperty("prepareBytesPerInstance", static_cast<juce::int64>(prepareBytes));
+            result->setProperty("statesRestored", run.statesRestored);
+            results.add(juce::var(result));
+        }
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("sampleRate", options.sampleRate);
+    report->setProperty("bufferSize", options.bufferSize);
+    report->setProperty("periodMs", 1.0e3 * period);
+    report->setProperty("channels", options.numChannels);
+    report->setProperty("quality", options.quality);
+    report->setProperty("bands", options.numBands);
+    report->setProperty("precision", options.doublePrecision ? "double" : "float");
+    report->setProperty("paced", options.paced);
+    report->setProperty("cores", juce::SystemStats::getNumCpus());
+    report->setProperty("results", results);
+
+    const auto json = juce::JSON::toString(juce::var(report));
+
+    if (options.outputPath.isNotEmpty())
+        juce::File::getCurrentWorkingDirectory().getChildFile(options.outputPath).replaceWithText(json);
+    else
+        std::cout << json << std::endl;
+
+    return 0;
+}
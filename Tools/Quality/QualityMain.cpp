@@ -0,0 +1,685 @@
+#include <juce_core/juce_core.h>
+#include <juce_dsp/juce_dsp.h>
+#include "PolyphaseIIR.h"
+#include "SaturatorDSP.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+// Headless audio quality check for SaturatorDSP.
+//
+// Runs stepped sines per mode and quality and measures THD, inharmonic
+// (aliased) energy and the noise floor from the output spectrum. A low-level
+// exponential sweep gives the small-signal frequency response. Every run
+// also checks the fused polyphase oversampler against the JUCE oversampler
+// it stands in for. The report is JSON; with --reference=<report.json> every
+// profile is compared against an earlier run, usually one made with
+// --kernel=exact, and the exit code is non-zero when any figure falls
+// outside its tolerance.
+
+namespace
+{
+    const char* getModeName(SaturatorDSPBase::Mode mode)
+    {
+        switch (mode)
+        {
+            case SaturatorDSPBase::Mode::Triode:  return "Triode";
+            case SaturatorDSPBase::Mode::Pentode: return "Pentode";
+            case SaturatorDSPBase::Mode::Torture: return "Torture";
+            default:                          return "";
+        }
+    }
+
+    const char* getQualityName(SaturatorDSPBase::Quality quality)
+    {
+        switch (quality)
+        {
+            case SaturatorDSPBase::Quality::Standard: return "Standard";
+            case SaturatorDSPBase::Quality::Live2x:   return "Live2x";
+            case SaturatorDSPBase::Quality::Live1x:   return "Live1x";
+            case SaturatorDSPBase::Quality::Fixed2x:  return "Fixed2x";
+            case SaturatorDSPBase::Quality::Fixed4x:  return "Fixed4x";
+            case SaturatorDSPBase::Quality::Fixed8x:  return "Fixed8x";
+            case SaturatorDSPBase::Quality::Fixed16x: return "Fixed16x";
+            default:                              return "";
+        }
+    }
+
+    const char* getFilterName(SaturatorDSPBase::Filter filter)
+    {
+        switch (filter)
+        {
+            case SaturatorDSPBase::Filter::PolyphaseIIR: return "iir";
+            case SaturatorDSPBase::Filter::HalfBandFIR:  return "fir";
+            default:                                  return "";
+        }
+    }
+
+    // Tones are analysed over one FFT frame after the chain has settled
+    constexpr int toneOrder = 14;
+    constexpr int toneLength = 1 << toneOrder;
+    constexpr double settleSeconds = 1.0;
+
+    // The sweep and its tail fit one FFT frame at up to 192 kHz
+    constexpr int sweepOrder = 18;
+    constexpr double sweepSeconds = 0.5;
+    constexpr double sweepStartHz = 10.0;
+    constexpr float sweepLevelDb = -50.0f;
+
+    constexpr int blockSize = 512;
+    constexpr double powerFloor = 1.0e-30;
+
+    double toDb(double powerRatio)
+    {
+        return 10.0 * std::log10(juce::jmax(powerFloor, powerRatio));
+    }
+
+    //==========================================================================
+    // Options
+    //==========================================================================
+
+    struct Options
+    {
+        juce::Array<SaturatorDSPBase::Mode> modes { SaturatorDSPBase::Mode::Triode,
+                                                SaturatorDSPBase::Mode::Pentode,
+                                                SaturatorDSPBase::Mode::Torture };
+        juce::Array<SaturatorDSPBase::Quality> qualities { SaturatorDSPBase::Quality::Standard };
+        juce::Array<double> tones { 100.0, 440.0, 1000.0, 2500.0, 5000.0, 10000.0, 15000.0 };
+        juce::Array<float> levelsDb { -18.0f, -6.0f };
+
+        ValveShaper::Kernel kernel = ValveShaper::Kernel::Fast;
+        SaturatorDSPBase::Filter filter = SaturatorDSPBase::Filter::PolyphaseIIR;
+        bool doublePrecision = false;
+        double sampleRate = 48000.0;
+        float driveDb = 20.0f;
+        float bias = 0.1f;
+        float sag = 0.15f;
+
+        juce::String outputPath;
+        juce::String referencePath;
+        double thdTolerance = 1.0;
+        double aliasingTolerance = 3.0;
+        double noiseTolerance = 6.0;
+        double responseTolerance = 0.5;
+        double oversamplerTolerance = 1.0e-6;
+    };
+
+    juce::StringArray getList(const juce::ArgumentList& args, const juce::String& option)
+    {
+        return juce::StringArray::fromTokens(args.getValueForOption(option), ",", {});
+    }
+
+    Options parseOptions(const juce::ArgumentList& args)
+    {
+        Options options;
+
+        if (args.containsOption("--modes"))
+        {
+            options.modes.clear();
+            for (auto& name : getList(args, "--modes"))
+                for (int m = 0; m < 3; ++m)
+                    if (name.equalsIgnoreCase(getModeName(static_cast<SaturatorDSPBase::Mode>(m))))
+                        options.modes.add(static_cast<SaturatorDSPBase::Mode>(m));
+        }
+
+        if (args.containsOption("--qualities"))
+        {
+            options.qualities.clear();
+            for (auto& name : getList(args, "--qualities"))
+                for (int q = 0; q < SaturatorDSPBase::numQualities; ++q)
+                    if (name.equalsIgnoreCase(getQualityName(static_cast<SaturatorDSPBase::Quality>(q))))
+                        options.qualities.add(static_cast<SaturatorDSPBase::Quality>(q));
+        }
+
+        if (args.containsOption("--tones"))
+        {
+            options.tones.clear();
+            for (auto& tone : getList(args, "--tones"))
+                options.tones.add(juce::jmax(10.0, tone.getDoubleValue()));
+        }
+
+        if (args.containsOption("--levels"))
+        {
+            options.levelsDb.clear();
+            for (auto& level : getList(args, "--levels"))
+                options.levelsDb.add(juce::jmin(0.0f, level.getFloatValue()));
+        }
+
+        if (args.getValueForOption("--kernel").equalsIgnoreCase("exact"))
+            options.kernel = ValveShaper::Kernel::Exact;
+
+        if (args.getValueForOption("--filter").equalsIgnoreCase(getFilterName(SaturatorDSPBase::Filter::HalfBandFIR)))
+            options.filter = SaturatorDSPBase::Filter::HalfBandFIR;
+
+        options.doublePrecision = args.getValueForOption("--precision").equalsIgnoreCase("double");
+
+        if (args.containsOption("--rate"))
+            options.sampleRate = juce::jlimit(22050.0, 192000.0, args.getValueForOption("--rate").getDoubleValue());
+
+        auto readFloat = [&args](const char* option, float& value, float low, float high)
+        {
+            if (args.containsOption(option))
+                value = juce::jlimit(low, high, args.getValueForOption(option).getFloatValue());
+        };
+
+        readFloat("--drive", options.driveDb, 0.0f, 60.0f);
+        readFloat("--bias", options.bias, -0.6f, 0.6f);
+        readFloat("--sag", options.sag, 0.0f, 0.6f);
+
+        auto readTolerance = [&args](const char* option, double& value)
+        {
+            if (args.containsOption(option))
+                value = juce::jmax(0.0, args.getValueForOption(option).getDoubleValue());
+        };
+
+        readTolerance("--thd-tolerance", options.thdTolerance);
+        readTolerance("--aliasing-tolerance", options.aliasingTolerance);
+        readTolerance("--noise-tolerance", options.noiseTolerance);
+        readTolerance("--response-tolerance", options.responseTolerance);
+        readTolerance("--oversampler-tolerance", options.oversamplerTolerance);
+
+        options.outputPath = args.getValueForOption("--output");
+        options.referencePath = args.getValueForOption("--reference");
+        return options;
+    }
+
+    //==========================================================================
+    // Processing
+    //==========================================================================
+
+    struct Case
+    {
+        SaturatorDSPBase::Mode mode;
+        SaturatorDSPBase::Quality quality;
+        SaturatorDSPBase::Filter filter;
+
+        juce::String getKey() const
+        {
+            // Same keys as the benchmark; the kernel is left out so a fast
+            // run can be checked against an exact reference
+            const juce::String filterSuffix = filter == SaturatorDSPBase::Filter::HalfBandFIR ? "-fir" : "";
+            return juce::String(getModeName(mode)) + "/" + getQualityName(quality) + filterSuffix;
+        }
+    };
+
+    // Runs a mono signal through a freshly prepared DSP, block by block
+    template <typename SampleType>
+    std::vector<float> processSignal(const Case& c, const Options& options, const std::vector<float>& input)
+    {
+        const SaturatorDSPBase::QualitySetting quality { c.quality, c.filter };
+
+        SaturatorDSP<SampleType> dsp;
+        dsp.setShaperKernel(options.kernel);
+        dsp.setQualitiesInUse({ quality });
+        dsp.prepare(options.sampleRate, blockSize, 1);
+
+        SaturatorDSPBase::Parameters params;
+        params.driveDb = options.driveDb;
+        params.bias = options.bias;
+        params.sagAmount = options.sag;
+        params.mix = 1.0f;
+
+        juce::AudioBuffer<SampleType> block(1, blockSize);
+        std::vector<float> output(input.size());
+
+        for (size_t pos = 0; pos < input.size(); pos += blockSize)
+        {
+            const auto numSamples = juce::jmin(static_cast<size_t>(blockSize), input.size() - pos);
+            block.setSize(1, static_cast<int>(numSamples), false, false, true);
+
+            auto* data = block.getWritePointer(0);
+            for (size_t i = 0; i < numSamples; ++i)
+                data[i] = static_cast<SampleType>(input[pos + i]);
+
+            dsp.process(block, params, c.mode, quality);
+
+            for (size_t i = 0; i < numSamples; ++i)
+                output[pos + i] = static_cast<float>(data[i]);
+        }
+
+        return output;
+    }
+
+    std::vector<float> processSignal(const Case& c, const Options& options, const std::vector<float>& input)
+    {
+        return options.doublePrecision ? processSignal<double>(c, options, input)
+                                       : processSignal<float>(c, options, input);
+    }
+
+    // Power per bin from 0 to Nyquist of the first 2^order samples
+    std::vector<double> getPowerSpectrum(const std::vector<float>& signal, size_t start, int order)
+    {
+        juce::dsp::FFT fft(order);
+        const auto size = static_cast<size_t>(fft.getSize());
+
+        std::vector<float> data(2 * size, 0.0f);
+        std::copy_n(signal.begin() + static_cast<std::ptrdiff_t>(start), juce::jmin(size, signal.size() - start),
+                    data.begin());
+        fft.performRealOnlyForwardTransform(data.data(), true);
+
+        std::vector<double> power(size / 2 + 1);
+        for (size_t k = 0; k < power.size(); ++k)
+        {
+            const auto re = static_cast<double>(data[2 * k]);
+            const auto im = static_cast<double>(data[2 * k + 1]);
+            power[k] = re * re + im * im;
+        }
+
+        return power;
+    }
+
+    //==========================================================================
+    // Stepped sines
+    //==========================================================================
+
+    struct ToneResult
+    {
+        double frequency = 0.0;
+        float levelDb = 0.0f;
+        double thdDb = 0.0;
+        double aliasingDb = 0.0;
+        double noiseFloorDb = 0.0;
+    };
+
+    // The tone sits on an odd bin of a power-of-two frame, and the settled
+    // output repeats exactly once per frame, so no window is needed. Every
+    // harmonic below Nyquist lands on a multiple of that bin, and a folded
+    // harmonic can never land on one: N is a power of two and the bin is
+    // odd. The rest is aliasing lines on top of a noise floor, taken as the
+    // median bin.
+    ToneResult measureTone(const Case& c, const Options& options, double frequency, float levelDb)
+    {
+        auto bin = static_cast<int>(std::round(frequency * toneLength / options.sampleRate));
+        bin = juce::jlimit(1, toneLength / 2 - 1, bin | 1);
+
+        const double omega = juce::MathConstants<double>::twoPi * bin / toneLength;
+        const auto amplitude = static_cast<double>(juce::Decibels::decibelsToGain(levelDb));
+        const auto settleLength = static_cast<size_t>(settleSeconds * options.sampleRate);
+
+        std::vector<float> input(settleLength + toneLength);
+        for (size_t i = 0; i < input.size(); ++i)
+            input[i] = static_cast<float>(amplitude * std::sin(omega * static_cast<double>(i % static_cast<size_t>(toneLength))));
+
+        const auto power = getPowerSpectrum(processSignal(c, options, input), settleLength, toneOrder);
+        const auto fundamentalBin = static_cast<size_t>(bin);
+        const double fundamental = juce::jmax(powerFloor, power[fundamentalBin]);
+
+        std::vector<bool> harmonic(power.size(), false);
+        double harmonicPower = 0.0;
+
+        for (size_t k = 2 * fundamentalBin; k < power.size() - 1; k += fundamentalBin)
+        {
+            harmonic[k] = true;
+            harmonicPower += power[k];
+        }
+
+        // DC and Nyquist are left out
+        std::vector<double> inharmonic;
+        for (size_t k = 1; k < power.size() - 1; ++k)
+            if (k != fundamentalBin && ! harmonic[k])
+                inharmonic.push_back(power[k]);
+
+        double inharmonicPower = 0.0;
+        for (auto p : inharmonic)
+            inharmonicPower += p;
+
+        auto middle = inharmonic.begin() + static_cast<std::ptrdiff_t>(inharmonic.size() / 2);
+        std::nth_element(inharmonic.begin(), middle, inharmonic.end());
+        const double noiseFloor = inharmonic.empty() ? 0.0 : *middle;
+        const double aliasingPower = juce::jmax(0.0, inharmonicPower - noiseFloor * static_cast<double>(inharmonic.size()));
+
+        ToneResult result;
+        result.frequency = bin * options.sampleRate / toneLength;
+        result.levelDb = levelDb;
+        result.thdDb = toDb(harmonicPower / fundamental);
+        result.aliasingDb = toDb(aliasingPower / fundamental);
+        result.noiseFloorDb = toDb(noiseFloor / fundamental);
+        return result;
+    }
+
+    //==========================================================================
+    // Frequency response
+    //==========================================================================
+
+    struct ResponsePoint
+    {
+        double frequency = 0.0;
+        double gainDb = 0.0;
+    };
+
+    // Output over input power per third-octave band, from a sweep quiet
+    // enough that the shaper and sag stay linear. Bias is left at 0: its DC
+    // step at the start of the sweep would leak into the low bands.
+    std::vector<ResponsePoint> measureResponse(const Case& c, const Options& options)
+    {
+        auto linearOptions = options;
+        linearOptions.bias = 0.0f;
+
+        const double sampleRate = options.sampleRate;
+        const auto sweepLength = static_cast<size_t>(sweepSeconds * sampleRate);
+        const double sweepEndHz = 0.49 * sampleRate;
+        const double rate = std::log(sweepEndHz / sweepStartHz);
+        const auto amplitude = static_cast<double>(juce::Decibels::decibelsToGain(sweepLevelDb));
+
+        std::vector<float> input(static_cast<size_t>(1) << sweepOrder, 0.0f);
+        for (size_t i = 0; i < sweepLength; ++i)
+        {
+            const double t = static_cast<double>(i) / sampleRate;
+            const double phase = juce::MathConstants<double>::twoPi * sweepStartHz * sweepSeconds / rate
+                               * (std::exp(t * rate / sweepSeconds) - 1.0);
+            input[i] = static_cast<float>(amplitude * std::sin(phase));
+        }
+
+        const auto inputPower = getPowerSpectrum(input, 0, sweepOrder);
+        const auto outputPower = getPowerSpectrum(processSignal(c, linearOptions, input), 0, sweepOrder);
+        const double binHz = sampleRate / static_cast<double>(input.size());
+
+        std::vector<ResponsePoint> points;
+
+        // ISO third-octave centres from 25 Hz, up to 0.45 fs
+        for (int band = -16; band <= 13; ++band)
+        {
+            const double centre = 1000.0 * std::pow(2.0, band / 3.0);
+            if (centre > 0.45 * sampleRate)
+                break;
+
+            const auto low = static_cast<size_t>(std::ceil(centre * std::pow(2.0, -1.0 / 6.0) / binHz));
+            const auto high = static_cast<size_t>(std::floor(centre * std::pow(2.0, 1.0 / 6.0) / binHz));
+
+            double in = 0.0, out = 0.0;
+            for (size_t k = low; k <= high && k < inputPower.size(); ++k)
+            {
+                in += inputPower[k];
+                out += outputPower[k];
+            }
+
+            points.push_back({ centre, toDb(out / juce::jmax(powerFloor, in)) });
+        }
+
+        return points;
+    }
+
+    //==========================================================================
+    // Oversampler equivalence
+    //==========================================================================
+
+    struct OversamplerResult
+    {
+        int factor = 0;
+        double latency = 0.0;
+        double referenceLatency = 0.0;
+        double maxError = 0.0;
+    };
+
+    // Runs noise through PolyphaseIIR and through the JUCE polyphase IIR
+    // oversampler it replaces, with the same tanh at the oversampled rate,
+    // and takes the largest output difference. Block sizes vary so tile
+    // and block boundaries fall everywhere.
+    template <typename SampleType>
+    OversamplerResult compareOversampler(int numStages)
+    {
+        using Reference = juce::dsp::Oversampling<SampleType>;
+        constexpr int maxBlockSize = 512;
+
+        Reference reference(1, static_cast<size_t>(numStages), Reference::filterHalfBandPolyphaseIIR, true);
+        reference.setUsingIntegerLatency(true);
+        reference.initProcessing(static_cast<size_t>(maxBlockSize));
+
+        PolyphaseIIR<SampleType> fused(numStages, 1);
+        std::vector<SampleType> tiles(2 * PolyphaseIIR<SampleType>::tileLength + ValveShaper::alignmentPadding);
+        auto* tile = ValveShaper::getAlignedPointer(tiles.data());
+
+        auto shape = [](SampleType* data, int numSamples)
+        {
+            for (int i = 0; i < numSamples; ++i)
+                data[i] = std::tanh(SampleType(4) * data[i]);
+        };
+
+        juce::Random random(1);
+        juce::AudioBuffer<SampleType> block(1, maxBlockSize);
+        std::vector<SampleType> output(static_cast<size_t>(maxBlockSize));
+
+        OversamplerResult result;
+        result.factor = 1 << numStages;
+        result.latency = static_cast<double>(fused.getLatencyInSamples());
+        result.referenceLatency = static_cast<double>(reference.getLatencyInSamples());
+
+        for (int b = 0; b < 64; ++b)
+        {
+            const int numSamples = 1 + random.nextInt(maxBlockSize);
+            block.setSize(1, numSamples, false, false, true);
+
+            auto* data = block.getWritePointer(0);
+            for (int i = 0; i < numSamples; ++i)
+                data[i] = static_cast<SampleType>(random.nextFloat() - 0.5f);
+
+            auto& state = fused.getState(0);
+            fused.process(data, output.data(), numSamples, state, tile,
+                          [&shape](SampleType* tileData, int, int length) { shape(tileData, length); });
+            PolyphaseIIR<SampleType>::snapToZero(state);
+
+            juce::dsp::AudioBlock<SampleType> hostBlock(block);
+            auto oversampled = reference.processSamplesUp(hostBlock);
+            shape(oversampled.getChannelPointer(0), static_cast<int>(oversampled.getNumSamples()));
+            reference.processSamplesDown(hostBlock);
+
+            for (int i = 0; i < numSamples; ++i)
+                result.maxError = juce::jmax(result.maxError,
+                                             static_cast<double>(std::abs(output[static_cast<size_t>(i)] - data[i])));
+        }
+
+        return result;
+    }
+
+    //==========================================================================
+    // Report
+    //==========================================================================
+
+    juce::var runCase(const Case& c, const Options& options)
+    {
+        juce::Array<juce::var> tones;
+
+        for (auto level : options.levelsDb)
+        {
+            for (auto frequency : options.tones)
+            {
+                if (frequency >= 0.45 * options.sampleRate)
+                    continue;
+
+                const auto tone = measureTone(c, options, frequency, level);
+
+                auto* object = new juce::DynamicObject();
+                object->setProperty("frequency", tone.frequency);
+                object->setProperty("levelDb", tone.levelDb);
+                object->setProperty("thdDb", tone.thdDb);
+                object->setProperty("aliasingDb", tone.aliasingDb);
+                object->setProperty("noiseFloorDb", tone.noiseFloorDb);
+                tones.add(juce::var(object));
+            }
+        }
+
+        juce::Array<juce::var> response;
+        for (const auto& point : measureResponse(c, options))
+        {
+            auto* object = new juce::DynamicObject();
+            object->setProperty("frequency", point.frequency);
+            object->setProperty("gainDb", point.gainDb);
+            response.add(juce::var(object));
+        }
+
+        auto* result = new juce::DynamicObject();
+        result->setProperty("key", c.getKey());
+        result->setProperty("mode", getModeName(c.mode));
+        result->setProperty("quality", getQualityName(c.quality));
+        result->setProperty("filter", getFilterName(c.filter));
+        result->setProperty("tones", tones);
+        result->setProperty("response", response);
+        return juce::var(result);
+    }
+
+    // Checks each profile against the reference profile with the same key.
+    // THD and response must stay within their tolerance either way; aliasing
+    // and the noise floor may only fall. Returns false on any failure.
+    bool compareWithReference(const juce::Array<juce::var>& results, const juce::var& reference, const Options& options)
+    {
+        std::map<juce::String, juce::var> referenceProfiles;
+        if (auto* profiles = reference["results"].getArray())
+            for (auto& profile : *profiles)
+                referenceProfiles[profile["key"].toString()] = profile;
+
+        bool passed = true;
+
+        auto check = [&passed](const juce::String& what, double current, double expected, double tolerance, bool upperOnly)
+        {
+            const double excess = upperOnly ? current - expected : std::abs(current - expected);
+            if (excess <= tolerance)
+                return;
+
+            std::cerr << "FAIL " << what << ": " << expected << " -> " << current << " dB" << std::endl;
+            passed = false;
+        };
+
+        for (auto& r : results)
+        {
+            const auto key = r["key"].toString();
+            auto it = referenceProfiles.find(key);
+            if (it == referenceProfiles.end())
+            {
+                std::cerr << "no reference for " << key << std::endl;
+                continue;
+            }
+
+            auto* tones = r["tones"].getArray();
+            auto* referenceTones = it->second["tones"].getArray();
+
+            if (tones != nullptr && referenceTones != nullptr)
+            {
+                for (auto& tone : *tones)
+                {
+                    for (auto& expected : *referenceTones)
+                    {
+                        if (! juce::approximatelyEqual(static_cast<double>(tone["frequency"]), static_cast<double>(expected["frequency"]))
+                            || ! juce::approximatelyEqual(static_cast<float>(tone["levelDb"]), static_cast<float>(expected["levelDb"])))
+                            continue;
+
+                        const auto name = key + " " + juce::String(static_cast<double>(tone["frequency"]), 1) + " Hz "
+                                        + juce::String(static_cast<float>(tone["levelDb"]), 1) + " dBFS ";
+
+                        check(name + "THD", tone["thdDb"], expected["thdDb"], options.thdTolerance, false);
+                        check(name + "aliasing", tone["aliasingDb"], expected["aliasingDb"], options.aliasingTolerance, true);
+                        check(name + "noise floor", tone["noiseFloorDb"], expected["noiseFloorDb"], options.noiseTolerance, true);
+                    }
+                }
+            }
+
+            auto* response = r["response"].getArray();
+            auto* referenceResponse = it->second["response"].getArray();
+
+            if (response != nullptr && referenceResponse != nullptr)
+            {
+                for (int i = 0; i < juce::jmin(response->size(), referenceResponse->size()); ++i)
+                {
+                    const auto& point = (*response)[i];
+                    check(key + " response " + juce::String(static_cast<double>(point["frequency"]), 0) + " Hz",
+                          point["gainDb"], (*referenceResponse)[i]["gainDb"], options.responseTolerance, false);
+                }
+            }
+        }
+
+        return passed;
+    }
+
+    void printUsage()
+    {
+        std::cout << "saturator-quality [options]\n"
+                     "  --modes=Triode,Pentode,Torture\n"
+                     "  --qualities=Standard,Live2x,Live1x,Fixed2x,Fixed4x,Fixed8x,Fixed16x\n"
+                     "  --filter=iir|fir         oversampling filter (default iir)\n"
+                     "  --tones=100,440,1000,2500,5000,10000,15000   stepped sine frequencies (Hz)\n"
+                     "  --levels=-18,-6          stepped sine levels (dBFS)\n"
+                     "  --rate=48000             sample rate\n"
+                     "  --drive=20 --bias=0.1 --sag=0.15\n"
+                     "  --kernel=fast|exact      valve shaper kernel (default fast)\n"
+                     "  --precision=float|double sample type to process (default float)\n"
+                     "  --output=<file.json>     write the report there instead of stdout\n"
+                     "  --reference=<file.json>  compare against an earlier report\n"
+                     "  --thd-tolerance=1        allowed THD change either way (dB)\n"
+                     "  --aliasing-tolerance=3   allowed aliasing increase (dB)\n"
+                     "  --noise-tolerance=6      allowed noise floor increase (dB)\n"
+                     "  --response-tolerance=0.5 allowed response change either way (dB)\n"
+                     "  --oversampler-tolerance=1e-6  allowed fused oversampler difference from JUCE's\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    juce::ScopedNoDenormals noDenormals;
+    const auto options = parseOptions(args);
+
+    juce::Array<juce::var> results;
+    juce::Array<juce::var> oversamplers;
+    bool passed = true;
+
+    for (int stages = 1; stages <= PolyphaseIIR<float>::maxStages; ++stages)
+    {
+        const auto o = options.doublePrecision ? compareOversampler<double>(stages)
+                                               : compareOversampler<float>(stages);
+
+        if (o.maxError > options.oversamplerTolerance || ! juce::approximatelyEqual(o.latency, o.referenceLatency))
+        {
+            std::cerr << "FAIL " << o.factor << "x polyphase oversampler: error " << o.maxError
+                      << ", latency " << o.latency << " (JUCE " << o.referenceLatency << ")" << std::endl;
+            passed = false;
+        }
+
+        auto* object = new juce::DynamicObject();
+        object->setProperty("factor", o.factor);
+        object->setProperty("latency", o.latency);
+        object->setProperty("maxError", o.maxError);
+        oversamplers.add(juce::var(object));
+    }
+
+    for (auto mode : options.modes)
+    {
+        for (auto quality : options.qualities)
+        {
+            const Case c { mode, quality, options.filter };
+            std::cerr << c.getKey() << std::endl;
+            results.add(runCase(c, options));
+        }
+    }
+
+    if (options.referencePath.isNotEmpty())
+    {
+        const auto referenceFile = juce::File::getCurrentWorkingDirectory().getChildFile(options.referencePath);
+        passed = compareWithReference(results, juce::JSON::parse(referenceFile.loadFileAsString()), options) && passed;
+    }
+
+    auto* report = new juce::DynamicObject();
+    report->setProperty("sampleRate", options.sampleRate);
+    report->setProperty("driveDb", options.driveDb);
+    report->setProperty("bias", options.bias);
+    report->setProperty("sag", options.sag);
+    report->setProperty("kernel", options.kernel == ValveShaper::Kernel::Exact ? "exact" : "fast");
+    report->setProperty("precision", options.doublePrecision ? "double" : "float");
+    report->setProperty("passed", passed);
+    report->setProperty("oversamplers", oversamplers);
+    report->setProperty("results", results);
+
+    const auto json = juce::JSON::toString(juce::var(report));
+
+    if (options.outputPath.isNotEmpty())
+        juce::File::getCurrentWorkingDirectory().getChildFile(options.outputPath).replaceWithText(json);
+    else
+        std::cout << json << std::endl;
+
+    return passed ? 0 : 1;
+}
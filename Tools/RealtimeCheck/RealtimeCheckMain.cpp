@@ -0,0 +1,938 @@
+#include <juce_core/juce_core.h>
+#include <juce_audio_processors/juce_audio_processors.h>
+#include "PluginProcessor.h"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#if JUCE_LINUX
+ #include <dlfcn.h>
+ #include <pthread.h>
+ #include <sched.h>
+ #include <semaphore.h>
+ #include <unistd.h>
+ #include <cstdarg>
+#endif
+
+#if JUCE_LINUX || JUCE_MAC
+ #include <execinfo.h>
+#endif
+
+#if JUCE_WINDOWS
+ #include <malloc.h>
+#endif
+
+// Realtime-safety check for SaturatorProcessor::processBlock.
+//
+// Drives the processor the way a host's audio thread does: parameter
+// automation, mode switches, quality, filter and band count changes with
+// and without a prepareToPlay in between, multiband with bands turning on
+// and off, switches between realtime and offline rendering, bursts of
+// silence, and block sizes from 0 to twice the announced size. While
+// processBlock runs, the calling thread flags every heap allocation or
+// release, mutex acquisition, blocking wait and system call. The exit code
+// is 1 if anything was flagged.
+//
+// operator new and delete are replaced on every platform. On Linux the C
+// allocator, the pthread locks and waits and the common blocking system
+// calls are hooked as well, so allocations and locks inside libraries are
+// caught too. Elsewhere only C++ allocations are seen.
+//
+// Parameter changes are made between blocks, outside the check, since
+// delivering them is the host's work.
+
+#if JUCE_LINUX
+// glibc's allocator under its own names, which the hooks forward to
+extern "C"
+{
+    void* __libc_malloc(size_t);
+    void* __libc_calloc(size_t, size_t);
+    void* __libc_realloc(void*, size_t);
+    void* __libc_memalign(size_t, size_t);
+    void __libc_free(void*);
+}
+#endif
+
+namespace
+{
+    //==========================================================================
+    // Violations
+    //==========================================================================
+
+    enum class Violation { Allocation, Deallocation, Lock, Wait, SystemCall, numViolations };
+
+    const char* getViolationName(Violation v)
+    {
+        switch (v)
+        {
+            case Violation::Allocation:   return "allocation";
+            case Violation::Deallocation: return "deallocation";
+            case Violation::Lock:         return "lock";
+            case Violation::Wait:         return "wait";
+            case Violation::SystemCall:   return "system call";
+            case Violation::numViolations:
+            default:                      return "";
+        }
+    }
+
+    // Set on a thread only while it is inside processBlock
+    thread_local bool checking = false;
+
+    // The first violations of a run, with their call stacks. Written only
+    // by the checked thread, read after it has finished.
+    constexpr int maxFrames = 32;
+
+    struct Record
+    {
+        Violation kind = Violation::Allocation;
+        const char* function = "";
+        int numFrames = 0;
+        void* frames[maxFrames] {};
+    };
+
+    constexpr int maxRecords = 8;
+    std::array<Record, maxRecords> records;
+    std::atomic<int> numRecords { 0 };
+    std::array<std::atomic<int>, static_cast<size_t>(Violation::numViolations)> violationCounts {};
+
+    // Called from the hooks. Records nothing outside processBlock, and
+    // suspends the check while recording so that it cannot flag itself.
+    void flag(Violation kind, const char* function)
+    {
+        if (! checking)
+            return;
+
+        checking = false;
+        ++violationCounts[static_cast<size_t>(kind)];
+
+        const int index = numRecords.fetch_add(1);
+        if (index < maxRecords)
+        {
+            auto& record = records[static_cast<size_t>(index)];
+            record.kind = kind;
+            record.function = function;
+           #if JUCE_LINUX || JUCE_MAC
+            record.numFrames = backtrace(record.frames, maxFrames);
+           #endif
+        }
+
+        checking = true;
+    }
+
+    int getTotalViolations()
+    {
+        int total = 0;
+        for (auto& count : violationCounts)
+            total += count.load();
+        return total;
+    }
+
+    void clearViolations()
+    {
+        for (auto& count : violationCounts)
+            count = 0;
+        numRecords = 0;
+    }
+
+    struct ScopedRealtimeCheck
+    {
+        ScopedRealtimeCheck() { checking = true; }
+        ~ScopedRealtimeCheck() { checking = false; }
+    };
+
+    //==========================================================================
+    // Unchecked allocation
+    //==========================================================================
+
+    // Used by the operator new replacements. On Linux this bypasses the
+    // malloc hooks below, so C++ allocations are not counted twice.
+    void* allocateUnchecked(std::size_t size)
+    {
+       #if JUCE_LINUX
+        return __libc_malloc(size == 0 ? 1 : size);
+       #else
+        return std::malloc(size == 0 ? 1 : size);
+       #endif
+    }
+
+    void* allocateAlignedUnchecked(std::size_t size, std::size_t alignment)
+    {
+       #if JUCE_WINDOWS
+        return _aligned_malloc(size == 0 ? 1 : size, alignment);
+       #elif JUCE_LINUX
+        return __libc_memalign(alignment, size == 0 ? 1 : size);
+       #else
+        void* p = nullptr;
+        return posix_memalign(&p, juce::jmax(alignment, sizeof(void*)), size == 0 ? 1 : size) == 0 ? p : nullptr;
+       #endif
+    }
+
+    void freeUnchecked(void* p)
+    {
+       #if JUCE_LINUX
+        __libc_free(p);
+       #else
+        std::free(p);
+       #endif
+    }
+
+    void freeAlignedUnchecked(void* p)
+    {
+       #if JUCE_WINDOWS
+        _aligned_free(p);
+       #else
+        freeUnchecked(p);
+       #endif
+    }
+
+    void* checkedNew(std::size_t size)
+    {
+        flag(Violation::Allocation, "operator new");
+
+        if (auto* p = allocateUnchecked(size))
+            return p;
+
+        throw std::bad_alloc();
+    }
+
+    void* checkedNew(std::size_t size, std::align_val_t alignment)
+    {
+        flag(Violation::Allocation, "operator new");
+
+        if (auto* p = allocateAlignedUnchecked(size, static_cast<std::size_t>(alignment)))
+            return p;
+
+        throw std::bad_alloc();
+    }
+
+    void checkedDelete(void* p)
+    {
+        if (p == nullptr)
+            return;
+
+        flag(Violation::Deallocation, "operator delete");
+        freeUnchecked(p);
+    }
+
+    void checkedDeleteAligned(void* p)
+    {
+        if (p == nullptr)
+            return;
+
+        flag(Violation::Deallocation, "operator delete");
+        freeAlignedUnchecked(p);
+    }
+}
+
+//==============================================================================
+// Replacement allocation functions
+//==============================================================================
+
+void* operator new(std::size_t size)                                         { return checkedNew(size); }
+void* operator new[](std::size_t size)                                       { return checkedNew(size); }
+void* operator new(std::size_t size, std::align_val_t a)                     { return checkedNew(size, a); }
+void* operator new[](std::size_t size, std::align_val_t a)                   { return checkedNew(size, a); }
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try { return checkedNew(size); } catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try { return checkedNew(size); } catch (...) { return nullptr; }
+}
+
+void* operator new(std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept
+{
+    try { return checkedNew(size, a); } catch (...) { return nullptr; }
+}
+
+void* operator new[](std::size_t size, std::align_val_t a, const std::nothrow_t&) noexcept
+{
+    try { return checkedNew(size, a); } catch (...) { return nullptr; }
+}
+
+void operator delete(void* p) noexcept                                       { checkedDelete(p); }
+void operator delete[](void* p) noexcept                                     { checkedDelete(p); }
+void operator delete(void* p, std::size_t) noexcept                          { checkedDelete(p); }
+void operator delete[](void* p, std::size_t) noexcept                        { checkedDelete(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept                { checkedDelete(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept              { checkedDelete(p); }
+void operator delete(void* p, std::align_val_t) noexcept                     { checkedDeleteAligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept                   { checkedDeleteAligned(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept        { checkedDeleteAligned(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept      { checkedDeleteAligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept   { checkedDeleteAligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { checkedDeleteAligned(p); }
+
+//==============================================================================
+// libc hooks (Linux)
+//==============================================================================
+
+#if JUCE_LINUX
+namespace
+{
+    // The definition a hook forwards to, looked up on first use. The
+    // allocator forwards to glibc's __libc_* entry points instead, since
+    // dlsym itself allocates.
+    template <typename Function>
+    struct NextSymbol
+    {
+        const char* name;
+        std::atomic<Function*> function { nullptr };
+
+        Function* get()
+        {
+            auto* f = function.load(std::memory_order_relaxed);
+
+            if (f == nullptr)
+            {
+                f = reinterpret_cast<Function*>(dlsym(RTLD_NEXT, name));
+                function.store(f, std::memory_order_relaxed);
+            }
+
+            return f;
+        }
+    };
+
+    NextSymbol<int(pthread_mutex_t*)> nextMutexLock { "pthread_mutex_lock" };
+    NextSymbol<int(pthread_rwlock_t*)> nextReadLock { "pthread_rwlock_rdlock" };
+    NextSymbol<int(pthread_rwlock_t*)> nextWriteLock { "pthread_rwlock_wrlock" };
+    NextSymbol<int(pthread_cond_t*, pthread_mutex_t*)> nextCondWait { "pthread_cond_wait" };
+    NextSymbol<int(pthread_cond_t*, pthread_mutex_t*, const timespec*)> nextCondTimedWait { "pthread_cond_timedwait" };
+    NextSymbol<int(sem_t*)> nextSemWait { "sem_wait" };
+    NextSymbol<ssize_t(int, void*, size_t)> nextRead { "read" };
+    NextSymbol<ssize_t(int, const void*, size_t)> nextWrite { "write" };
+    NextSymbol<int(const timespec*, timespec*)> nextNanosleep { "nanosleep" };
+    NextSymbol<int(useconds_t)> nextUsleep { "usleep" };
+    NextSymbol<int()> nextYield { "sched_yield" };
+    NextSymbol<long(long, long, long, long, long, long, long)> nextSyscall { "syscall" };
+}
+
+extern "C"
+{
+    void* malloc(size_t size) noexcept
+    {
+        flag(Violation::Allocation, "malloc");
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) noexcept
+    {
+        flag(Violation::Allocation, "calloc");
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size) noexcept
+    {
+        flag(Violation::Allocation, "realloc");
+        return __libc_realloc(p, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) noexcept
+    {
+        flag(Violation::Allocation, "memalign");
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept
+    {
+        flag(Violation::Allocation, "aligned_alloc");
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size) noexcept
+    {
+        flag(Violation::Allocation, "posix_memalign");
+
+        if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+            return EINVAL;
+
+        *result = __libc_memalign(alignment, size);
+        return *result != nullptr ? 0 : ENOMEM;
+    }
+
+    void free(void* p) noexcept
+    {
+        if (p != nullptr)
+            flag(Violation::Deallocation, "free");
+
+        __libc_free(p);
+    }
+
+    int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept
+    {
+        flag(Violation::Lock, "pthread_mutex_lock");
+        return nextMutexLock.get()(mutex);
+    }
+
+    int pthread_rwlock_rdlock(pthread_rwlock_t* lock) noexcept
+    {
+        flag(Violation::Lock, "pthread_rwlock_rdlock");
+        return nextReadLock.get()(lock);
+    }
+
+    int pthread_rwlock_wrlock(pthread_rwlock_t* lock) noexcept
+    {
+        flag(Violation::Lock, "pthread_rwlock_wrlock");
+        return nextWriteLock.get()(lock);
+    }
+
+    int pthread_cond_wait(pthread_cond_t* cond, pthread_mutex_t* mutex)
+    {
+        flag(Violation::Wait, "pthread_cond_wait");
+        return nextCondWait.get()(cond, mutex);
+    }
+
+    int pthread_cond_timedwait(pthread_cond_t* cond, pthread_mutex_t* mutex, const timespec* time)
+    {
+        flag(Violation::Wait, "pthread_cond_timedwait");
+        return nextCondTimedWait.get()(cond, mutex, time);
+    }
+
+    int sem_wait(sem_t* semaphore)
+    {
+        flag(Violation::Wait, "sem_wait");
+        return nextSemWait.get()(semaphore);
+    }
+
+    int nanosleep(const timespec* duration, timespec* remaining)
+    {
+        flag(Violation::Wait, "nanosleep");
+        return nextNanosleep.get()(duration, remaining);
+    }
+
+    int usleep(useconds_t duration)
+    {
+        flag(Violation::Wait, "usleep");
+        return nextUsleep.get()(duration);
+    }
+
+    int sched_yield() noexcept
+    {
+        flag(Violation::Wait, "sched_yield");
+        return nextYield.get()();
+    }
+
+    ssize_t read(int fd, void* buffer, size_t size)
+    {
+        flag(Violation::SystemCall, "read");
+        return nextRead.get()(fd, buffer, size);
+    }
+
+    ssize_t write(int fd, const void* buffer, size_t size)
+    {
+        flag(Violation::SystemCall, "write");
+        return nextWrite.get()(fd, buffer, size);
+    }
+
+    // Raw system calls, e.g. futex waits from std::atomic::wait
+    long syscall(long number, ...) noexcept
+    {
+        flag(Violation::SystemCall, "syscall");
+
+        va_list args;
+        va_start(args, number);
+        long a[6];
+        for (auto& arg : a)
+            arg = va_arg(args, long);
+        va_end(args);
+
+        return nextSyscall.get()(number, a[0], a[1], a[2], a[3], a[4], a[5]);
+    }
+}
+#endif
+
+namespace
+{
+    //==========================================================================
+    // Options
+    //==========================================================================
+
+    struct Options
+    {
+        double sampleRate = 48000.0;
+        int blockSize = 512;
+        int numChannels = 2;
+        int numBlocks = 2000;   // per scenario and precision
+        juce::int64 seed = 1;
+        bool singlePrecision = true;
+        bool doublePrecision = true;
+    };
+
+    //==========================================================================
+    // Host
+    //==========================================================================
+
+    // Owns a processor and plays the host's part: parameter changes,
+    // prepareToPlay and the audio callback
+    class Host
+    {
+    public:
+        Host(const Options& o, bool useDouble)
+            : options(o), doublePrecision(useDouble), random(o.seed)
+        {
+            juce::AudioProcessor::BusesLayout layout;
+            layout.inputBuses.add(juce::AudioChannelSet::canonicalChannelSet(options.numChannels));
+            layout.outputBuses.add(juce::AudioChannelSet::canonicalChannelSet(options.numChannels));
+            layoutSupported = processor.setBusesLayout(layout);
+
+            processor.setProcessingPrecision(doublePrecision ? juce::AudioProcessor::doublePrecision
+                                                             : juce::AudioProcessor::singlePrecision);
+            processor.setNonRealtime(false);
+
+            // Twice the announced size, so hosts exceeding it are covered
+            floatBuffer.setSize(options.numChannels, 2 * options.blockSize);
+            doubleBuffer.setSize(options.numChannels, 2 * options.blockSize);
+        }
+
+        bool isLayoutSupported() const { return layoutSupported; }
+
+        // Plain value, as shown to the user; choices take their index
+        void set(const char* id, float value)
+        {
+            auto* param = processor.getAPVTS().getParameter(id);
+            jassert(param != nullptr);
+            param->setValueNotifyingHost(param->convertTo0to1(value));
+        }
+
+        float get(const char* id)
+        {
+            return processor.getAPVTS().getRawParameterValue(id)->load();
+        }
+
+        float uniform(float low, float high) { return low + (high - low) * random.nextFloat(); }
+        float pick(int numChoices) { return static_cast<float>(random.nextInt(numChoices)); }
+
+        // As the host flags a bounce; takes effect from the next block
+        void setNonRealtime(bool nonRealtime) { processor.setNonRealtime(nonRealtime); }
+        bool chance(float probability) { return random.nextFloat() < probability; }
+
+        void prepare()
+        {
+            processor.setRateAndBufferSizeDetails(options.sampleRate, options.blockSize);
+            processor.prepareToPlay(options.sampleRate, options.blockSize);
+            silentBlocks = 0;
+        }
+
+        // One audio callback. Signal and block size are varied outside the
+        // check; only processBlock runs inside it.
+        void processNextBlock()
+        {
+            // Mostly random sizes up to the announced one, sometimes the
+            // announced size exactly, twice it or an empty block
+            int numSamples = 1 + random.nextInt(options.blockSize);
+            if (chance(0.1f))       numSamples = options.blockSize;
+            else if (chance(0.05f)) numSamples = 2 * options.blockSize;
+            else if (chance(0.02f)) numSamples = 0;
+
+            // Noise at a varying level, with stretches of silence long
+            // enough for the tail to run out
+            if (silentBlocks > 0)
+                --silentBlocks;
+            else if (chance(0.005f))
+                silentBlocks = 200;
+
+            const float level = silentBlocks > 0 ? 0.0f : uniform(0.0f, 1.0f);
+
+            if (doublePrecision)
+                runBlock(doubleBuffer, numSamples, level);
+            else
+                runBlock(floatBuffer, numSamples, level);
+        }
+
+    private:
+        template <typename SampleType>
+        void runBlock(juce::AudioBuffer<SampleType>& storage, int numSamples, float level)
+        {
+            for (int ch = 0; ch < options.numChannels; ++ch)
+            {
+                auto* data = storage.getWritePointer(ch);
+                for (int i = 0; i < numSamples; ++i)
+                    data[i] = static_cast<SampleType>(level * (2.0f * random.nextFloat() - 1.0f));
+            }
+
+            juce::AudioBuffer<SampleType> block(storage.getArrayOfWritePointers(), options.numChannels, numSamples);
+
+            {
+                const ScopedRealtimeCheck check;
+                processor.processBlock(block, midi);
+            }
+        }
+
+        const Options& options;
+        const bool doublePrecision;
+        juce::Random random;
+
+        SaturatorProcessor processor;
+        bool layoutSupported = false;
+
+        juce::AudioBuffer<float> floatBuffer;
+        juce::AudioBuffer<double> doubleBuffer;
+        juce::MidiBuffer midi;
+        int silentBlocks = 0;
+    };
+
+    //==========================================================================
+    // Scenarios
+    //==========================================================================
+
+    // New targets for the continuous controls, which the processor then
+    // ramps to over the following blocks
+    void automateControls(Host& host)
+    {
+        host.set("inputTrim", host.uniform(-24.0f, 24.0f));
+        host.set("drive", host.uniform(0.0f, 60.0f));
+        host.set("bias", host.uniform(-0.6f, 0.6f));
+        host.set("sag", host.uniform(0.0f, 0.6f));
+        host.set("outputTrim", host.uniform(-24.0f, 6.0f));
+        host.set("mix", host.uniform(0.0f, 100.0f));
+    }
+
+    void automateMode(Host& host)
+    {
+        host.set("mode", static_cast<float>(juce::roundToInt(host.uniform(0.0f, 2.0f))));
+    }
+
+    // Per-band drive, bias and sag, with bands turned off and on through
+    // their drive, and moving crossovers
+    void automateBands(Host& host)
+    {
+        const char* const bandIds[] = { "low", "mid", "high" };
+
+        for (auto* id : bandIds)
+        {
+            const juce::String prefix(id);
+
+            if (host.chance(0.02f))
+                host.set((prefix + "Drive").toRawUTF8(), host.chance(0.3f) ? 0.0f : host.uniform(0.0f, 60.0f));
+
+            if (host.chance(0.1f))
+            {
+                host.set((prefix + "Bias").toRawUTF8(), host.uniform(-0.6f, 0.6f));
+                host.set((prefix + "Sag").toRawUTF8(), host.uniform(0.0f, 0.6f));
+            }
+        }
+
+        if (host.chance(0.05f))
+        {
+            host.set("lowCrossover", host.uniform(40.0f, 1000.0f));
+            host.set("highCrossover", host.uniform(1000.0f, 10000.0f));
+        }
+    }
+
+    // Full-band: continuous automation and mode switches at the default
+    // quality
+    void runAutomation(Host& host, int numBlocks)
+    {
+        host.prepare();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            if (host.chance(0.3f))
+                automateControls(host);
+
+            if (host.chance(0.03f))
+                automateMode(host);
+
+            host.processNextBlock();
+        }
+    }
+
+    // Every quality as the realtime setting, switching to and from an
+    // offline setting with the other filter. prepareToPlay lists both, so
+    // no switch may build anything.
+    void runQualitySwitches(Host& host, int numBlocks)
+    {
+        const int blocksPerQuality = juce::jmax(1, numBlocks / SaturatorDSPBase::numQualities);
+
+        for (int q = 0; q < SaturatorDSPBase::numQualities; ++q)
+        {
+            const int other = (q + 3) % SaturatorDSPBase::numQualities;
+
+            host.set("quality", static_cast<float>(q));
+            host.set("filter", 0.0f);
+            host.set("offlineQuality", static_cast<float>(other + 1));
+            host.set("offlineFilter", 2.0f);
+            host.prepare();
+
+            for (int b = 0; b < blocksPerQuality; ++b)
+            {
+                if (host.chance(0.02f))
+                {
+                    const bool toOffline = juce::roundToInt(host.get("quality")) == q;
+                    host.set("quality", static_cast<float>(toOffline ? other : q));
+                    host.set("filter", toOffline ? 1.0f : 0.0f);
+                }
+
+                if (host.chance(0.3f))
+                    automateControls(host);
+
+                if (host.chance(0.03f))
+                    automateMode(host);
+
+                host.processNextBlock();
+            }
+        }
+    }
+
+    // 2 and 3 bands with per-band automation
+    void runMultiband(Host& host, int numBlocks)
+    {
+        for (int numBands = 2; numBands <= SaturatorDSPBase::maxBands; ++numBands)
+        {
+            host.set("bands", static_cast<float>(numBands - 1));
+            host.prepare();
+
+            for (int b = 0; b < numBlocks / 2; ++b)
+            {
+                automateBands(host);
+
+                if (host.chance(0.3f))
+                    automateControls(host);
+
+                if (host.chance(0.03f))
+                    automateMode(host);
+
+                host.processNextBlock();
+            }
+        }
+    }
+
+    // Quality and filter picked at random from the full-band chain, as a
+    // user would from the editor, after a single prepareToPlay at the
+    // defaults
+    void runFreeQuality(Host& host, int numBlocks)
+    {
+        host.prepare();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            if (host.chance(0.02f))
+                host.set("quality", host.pick(SaturatorDSPBase::numQualities));
+
+            if (host.chance(0.02f))
+                host.set("filter", host.pick(SaturatorDSPBase::numFilters));
+
+            if (host.chance(0.3f))
+                automateControls(host);
+
+            if (host.chance(0.03f))
+                automateMode(host);
+
+            host.processNextBlock();
+        }
+    }
+
+    // Band count, quality and filter picked at random after a single
+    // prepareToPlay with the full-band chain
+    void runFreeBands(Host& host, int numBlocks)
+    {
+        host.prepare();
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            if (host.chance(0.02f))
+                host.set("bands", host.pick(SaturatorDSPBase::maxBands));
+
+            if (host.chance(0.01f))
+                host.set("quality", host.pick(SaturatorDSPBase::numQualities));
+
+            if (host.chance(0.01f))
+                host.set("filter", host.pick(SaturatorDSPBase::numFilters));
+
+            automateBands(host);
+
+            if (host.chance(0.3f))
+                automateControls(host);
+
+            if (host.chance(0.03f))
+                automateMode(host);
+
+            host.processNextBlock();
+        }
+    }
+
+    // Realtime and offline rendering toggled between blocks with no
+    // prepareToPlay in between. Prepared offline with three bands, so the
+    // first stretch runs the bands on the worker pool. Each toggle swaps in
+    // the other prepared quality and filter, and the first return to
+    // realtime drops the processor to one thread.
+    void runOfflineSwitches(Host& host, int numBlocks)
+    {
+        host.set("quality", 0.0f);
+        host.set("filter", 0.0f);
+        host.set("offlineQuality", 6.0f);   // 8x
+        host.set("offlineFilter", 2.0f);    // FIR
+        host.set("bands", 2.0f);
+        host.setNonRealtime(true);
+        host.prepare();
+
+        bool offline = true;
+
+        for (int b = 0; b < numBlocks; ++b)
+        {
+            if (b >= numBlocks / 4 && host.chance(0.02f))
+            {
+                offline = ! offline;
+                host.setNonRealtime(offline);
+            }
+
+            automateBands(host);
+
+            if (host.chance(0.3f))
+                automateControls(host);
+
+            if (host.chance(0.03f))
+                automateMode(host);
+
+            host.processNextBlock();
+        }
+    }
+
+    struct Scenario
+    {
+        const char* name;
+        void (*run)(Host&, int);
+    };
+
+    const Scenario scenarios[] = {
+        { "automation", runAutomation },
+        { "quality", runQualitySwitches },
+        { "multiband", runMultiband },
+        { "free-quality", runFreeQuality },
+        { "free-bands", runFreeBands },
+        { "offline-switch", runOfflineSwitches },
+    };
+
+    //==========================================================================
+    // Report
+    //==========================================================================
+
+    void printViolations()
+    {
+        for (int v = 0; v < static_cast<int>(Violation::numViolations); ++v)
+            if (const int count = violationCounts[static_cast<size_t>(v)].load(); count > 0)
+                std::cerr << "  " << count << " x " << getViolationName(static_cast<Violation>(v)) << std::endl;
+
+        const int numShown = juce::jmin(numRecords.load(), maxRecords);
+
+        for (int r = 0; r < numShown; ++r)
+        {
+            auto& record = records[static_cast<size_t>(r)];
+            std::cerr << "  #" << (r + 1) << " " << getViolationName(record.kind) << " in " << record.function << std::endl;
+
+           #if JUCE_LINUX || JUCE_MAC
+            std::cerr.flush();
+            backtrace_symbols_fd(record.frames, record.numFrames, 2);
+           #endif
+        }
+    }
+
+    bool parseOptions(const juce::ArgumentList& args, Options& options)
+    {
+        if (args.containsOption("--rate"))
+            options.sampleRate = juce::jlimit(22050.0, 384000.0, args.getValueForOption("--rate").getDoubleValue());
+
+        if (args.containsOption("--block"))
+            options.blockSize = juce::jlimit(1, 8192, args.getValueForOption("--block").getIntValue());
+
+        if (args.containsOption("--channels"))
+            options.numChannels = juce::jlimit(1, SaturatorDSPBase::maxChannels, args.getValueForOption("--channels").getIntValue());
+
+        if (args.containsOption("--blocks"))
+            options.numBlocks = juce::jmax(1, args.getValueForOption("--blocks").getIntValue());
+
+        if (args.containsOption("--seed"))
+            options.seed = args.getValueForOption("--seed").getLargeIntValue();
+
+        if (args.containsOption("--precision"))
+        {
+            const auto precision = args.getValueForOption("--precision");
+            options.singlePrecision = precision != "double";
+            options.doublePrecision = precision != "float";
+
+            if (! options.singlePrecision && ! options.doublePrecision)
+                return false;
+        }
+
+        return true;
+    }
+
+    void printUsage()
+    {
+        std::cout << "saturator-realtime-check [options]\n"
+                     "  --rate=48000            sample rate\n"
+                     "  --block=512             block size announced to prepareToPlay\n"
+                     "  --channels=2            channel count\n"
+                     "  --blocks=2000           audio callbacks per scenario and precision\n"
+                     "  --precision=float|double|both  (default both)\n"
+                     "  --seed=1                random seed for signal, sizes and automation\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    Options options;
+    if (! parseOptions(args, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    // The parameter tree's timer needs a message manager
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+   #if JUCE_LINUX || JUCE_MAC
+    // backtrace() loads its unwinder on first use, which allocates
+    void* warmUp[1];
+    backtrace(warmUp, 1);
+   #endif
+
+    // The processor's parameter tree runs a timer, so processors are made
+    // and destroyed on this, the message thread, which then also plays the
+    // audio thread. The check is per thread, so which one does not matter.
+    int failures = 0;
+
+    for (const bool useDouble : { false, true })
+    {
+        if (useDouble ? ! options.doublePrecision : ! options.singlePrecision)
+            continue;
+
+        for (auto& scenario : scenarios)
+        {
+            Host host(options, useDouble);
+
+            if (! host.isLayoutSupported())
+            {
+                std::cerr << "Unsupported layout: " << options.numChannels << " channels" << std::endl;
+                return 1;
+            }
+
+            clearViolations();
+            scenario.run(host, options.numBlocks);
+
+            const int total = getTotalViolations();
+            std::cout << scenario.name << " (" << (useDouble ? "double" : "float") << "): "
+                      << (total == 0 ? "clean" : "FAILED") << std::endl;
+
+            if (total > 0)
+            {
+                printViolations();
+                ++failures;
+            }
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,500 @@
+#include <juce_core/juce_core.h>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_dsp/juce_dsp.h>
+#include "SaturatorDSP.h"
+#include <atomic>
+#include <iostream>
+
+// Offline batch renderer for SaturatorDSP.
+//
+// Streams each input file through the DSP in fixed-size chunks and writes a
+// WAV next to it (or into --output-dir). Files are rendered concurrently on
+// a thread pool, one DSP instance per file. The oversampling latency is
+// trimmed from the start and flushed at the end, so every output has the
+// same length as its input and lines up with it sample for sample.
+//
+// Parameters come from a state file saved by the plugin (--state), with any
+// of the per-parameter flags overriding it.
+
+namespace
+{
+    const char* getModeName(SaturatorDSPBase::Mode mode)
+    {
+        switch (mode)
+        {
+            case SaturatorDSPBase::Mode::Triode:  return "Triode";
+            case SaturatorDSPBase::Mode::Pentode: return "Pentode";
+            case SaturatorDSPBase::Mode::Torture: return "Torture";
+            default:                          return "";
+        }
+    }
+
+    const char* getQualityName(SaturatorDSPBase::Quality quality)
+    {
+        switch (quality)
+        {
+            case SaturatorDSPBase::Quality::Standard: return "Standard";
+            case SaturatorDSPBase::Quality::Live2x:   return "Live2x";
+            case SaturatorDSPBase::Quality::Live1x:   return "Live1x";
+            case SaturatorDSPBase::Quality::Fixed2x:  return "Fixed2x";
+            case SaturatorDSPBase::Quality::Fixed4x:  return "Fixed4x";
+            case SaturatorDSPBase::Quality::Fixed8x:  return "Fixed8x";
+            case SaturatorDSPBase::Quality::Fixed16x: return "Fixed16x";
+            default:                              return "";
+        }
+    }
+
+    const char* getFilterName(SaturatorDSPBase::Filter filter)
+    {
+        switch (filter)
+        {
+            case SaturatorDSPBase::Filter::PolyphaseIIR: return "iir";
+            case SaturatorDSPBase::Filter::HalfBandFIR:  return "fir";
+            default:                                  return "";
+        }
+    }
+
+    //==========================================================================
+    // Settings
+    //==========================================================================
+
+    // Plain parameter values, in the units the plugin stores them in
+    struct Settings
+    {
+        float inputTrimDb = 0.0f;
+        float driveDb = 20.0f;
+        float bias = 0.0f;
+        float sag = 0.15f;
+        float outputTrimDb = 0.0f;
+        float mixPercent = 100.0f;
+        SaturatorDSPBase::Mode mode = SaturatorDSPBase::Mode::Triode;
+        SaturatorDSPBase::Quality quality = SaturatorDSPBase::Quality::Standard;
+        SaturatorDSPBase::Filter filter = SaturatorDSPBase::Filter::PolyphaseIIR;
+        ValveShaper::Kernel kernel = ValveShaper::Kernel::Fast;
+        SaturatorDSPBase::SagDetector sagDetector = SaturatorDSPBase::SagDetector::Peak;
+        bool sagLinked = false;
+
+        // Multiband: 1 = off. Bands are low, mid, high as in the plugin.
+        int numBands = 1;
+        float lowCrossoverHz = 200.0f;
+        float highCrossoverHz = 2500.0f;
+        std::array<float, SaturatorDSPBase::maxBands> bandDriveDb { 12.0f, 12.0f, 12.0f };
+        std::array<float, SaturatorDSPBase::maxBands> bandBias {};
+        std::array<float, SaturatorDSPBase::maxBands> bandSag { 0.15f, 0.15f, 0.15f };
+
+        SaturatorDSPBase::Parameters toParameters() const
+        {
+            SaturatorDSPBase::Parameters params;
+            params.inputTrimDb = inputTrimDb;
+            params.driveDb = driveDb;
+            params.bias = bias;
+            params.sagAmount = sag;
+            params.outputTrimDb = outputTrimDb;
+            params.mix = mixPercent / 100.0f;
+
+            params.numBands = numBands;
+            params.lowCrossoverHz = lowCrossoverHz;
+            params.highCrossoverHz = highCrossoverHz;
+
+            // With two bands the high controls take the upper band
+            for (size_t b = 0; b < params.bands.size(); ++b)
+            {
+                const size_t source = (numBands == 2 && b == 1) ? 2 : b;
+                params.bands[b].driveDb = bandDriveDb[source];
+                params.bands[b].bias = bandBias[source];
+                params.bands[b].sagAmount = bandSag[source];
+            }
+
+            return params;
+        }
+    };
+
+    // Accepts the XML written by getStateInformation, either as saved by
+    // the plugin (JUCE's binary wrapper) or as plain text
+    std::unique_ptr<juce::XmlElement> loadStateXml(const juce::File& file)
+    {
+        if (auto xml = juce::parseXML(file))
+            return xml;
+
+        juce::MemoryBlock data;
+        if (! file.loadFileAsData(data) || data.getSize() < 8)
+            return {};
+
+        // copyXmlToBinary: magic, text length, then the XML as UTF-8
+        constexpr juce::uint32 magicXmlNumber = 0x21324356;
+        juce::MemoryInputStream stream(data, false);
+
+        if (static_cast<juce::uint32>(stream.readInt()) != magicXmlNumber)
+            return {};
+
+        const auto length = static_cast<size_t>(juce::jmax(0, stream.readInt()));
+        const auto available = static_cast<size_t>(stream.getNumBytesRemaining());
+        const auto* text = static_cast<const char*>(data.getData()) + 8;
+
+        return juce::parseXML(juce::String::fromUTF8(text, static_cast<int>(juce::jmin(length, available))));
+    }
+
+    bool applyState(const juce::XmlElement& state, Settings& settings)
+    {
+        bool found = false;
+
+        auto read = [&state, &found](const char* id, float& value)
+        {
+            if (auto* param = state.getChildByAttribute("id", id))
+            {
+                value = static_cast<float>(param->getDoubleAttribute("value", value));
+                found = true;
+            }
+        };
+
+        float modeIndex = static_cast<float>(settings.mode);
+        float qualityIndex = static_cast<float>(settings.quality);
+        float filterIndex = static_cast<float>(settings.filter);
+        float offlineQualityIndex = 0.0f;
+        float offlineFilterIndex = 0.0f;
+        float bandsIndex = static_cast<float>(settings.numBands - 1);
+
+        read("inputTrim", settings.inputTrimDb);
+        read("drive", settings.driveDb);
+        read("bias", settings.bias);
+        read("sag", settings.sag);
+        read("outputTrim", settings.outputTrimDb);
+        read("mix", settings.mixPercent);
+        read("mode", modeIndex);
+        read("quality", qualityIndex);
+        read("filter", filterIndex);
+        read("offlineQuality", offlineQualityIndex);
+        read("offlineFilter", offlineFilterIndex);
+        read("bands", bandsIndex);
+        read("lowCrossover", settings.lowCrossoverHz);
+        read("highCrossover", settings.highCrossoverHz);
+
+        const char* bandIds[] = { "low", "mid", "high" };
+        for (size_t b = 0; b < settings.bandDriveDb.size(); ++b)
+        {
+            const juce::String id(bandIds[b]);
+            read((id + "Drive").toRawUTF8(), settings.bandDriveDb[b]);
+            read((id + "Bias").toRawUTF8(), settings.bandBias[b]);
+            read((id + "Sag").toRawUTF8(), settings.bandSag[b]);
+        }
+
+        settings.numBands = juce::jlimit(1, SaturatorDSPBase::maxBands, juce::roundToInt(bandsIndex) + 1);
+
+        // A render is offline, so the offline choices win where they are set
+        if (juce::roundToInt(offlineQualityIndex) > 0)
+            qualityIndex = offlineQualityIndex - 1.0f;
+
+        if (juce::roundToInt(offlineFilterIndex) > 0)
+            filterIndex = offlineFilterIndex - 1.0f;
+
+        settings.mode = static_cast<SaturatorDSPBase::Mode>(juce::jlimit(0, 2, juce::roundToInt(modeIndex)));
+        settings.quality = static_cast<SaturatorDSPBase::Quality>(
+            juce::jlimit(0, SaturatorDSPBase::numQualities - 1, juce::roundToInt(qualityIndex)));
+        settings.filter = static_cast<SaturatorDSPBase::Filter>(
+            juce::jlimit(0, SaturatorDSPBase::numFilters - 1, juce::roundToInt(filterIndex)));
+        return found;
+    }
+
+    //==========================================================================
+    // Options
+    //==========================================================================
+
+    struct Options
+    {
+        Settings settings;
+        juce::Array<juce::File> inputs;
+        juce::File outputDir;
+        juce::String suffix = "_saturated";
+        int bitDepth = 0;   // 0 = same as the input where possible
+        int chunkSize = 4096;
+        int numJobs = juce::SystemStats::getNumCpus();
+    };
+
+    bool parseOptions(const juce::ArgumentList& args, Options& options)
+    {
+        auto& settings = options.settings;
+
+        if (args.containsOption("--state"))
+        {
+            const auto stateFile = args.getFileForOption("--state");
+            auto xml = stateFile.existsAsFile() ? loadStateXml(stateFile) : nullptr;
+
+            if (xml == nullptr || ! applyState(*xml, settings))
+            {
+                std::cerr << "Could not read plugin state from " << stateFile.getFullPathName() << std::endl;
+                return false;
+            }
+        }
+
+        auto readFloat = [&args](const char* option, float& value, float low, float high)
+        {
+            if (args.containsOption(option))
+                value = juce::jlimit(low, high, args.getValueForOption(option).getFloatValue());
+        };
+
+        readFloat("--input-trim", settings.inputTrimDb, -24.0f, 24.0f);
+        readFloat("--drive", settings.driveDb, 0.0f, 60.0f);
+        readFloat("--bias", settings.bias, -0.6f, 0.6f);
+        readFloat("--sag", settings.sag, 0.0f, 0.6f);
+        readFloat("--output-trim", settings.outputTrimDb, -24.0f, 24.0f);
+        readFloat("--mix", settings.mixPercent, 0.0f, 100.0f);
+
+        if (args.containsOption("--bands"))
+            settings.numBands = juce::jlimit(1, SaturatorDSPBase::maxBands, args.getValueForOption("--bands").getIntValue());
+
+        readFloat("--low-crossover", settings.lowCrossoverHz, 40.0f, 1000.0f);
+        readFloat("--high-crossover", settings.highCrossoverHz, 1000.0f, 10000.0f);
+        readFloat("--low-drive", settings.bandDriveDb[0], 0.0f, 60.0f);
+        readFloat("--mid-drive", settings.bandDriveDb[1], 0.0f, 60.0f);
+        readFloat("--high-drive", settings.bandDriveDb[2], 0.0f, 60.0f);
+
+        if (args.containsOption("--mode"))
+        {
+            const auto name = args.getValueForOption("--mode");
+            for (int m = 0; m < 3; ++m)
+                if (name.equalsIgnoreCase(getModeName(static_cast<SaturatorDSPBase::Mode>(m))))
+                    settings.mode = static_cast<SaturatorDSPBase::Mode>(m);
+        }
+
+        if (args.containsOption("--quality"))
+        {
+            const auto name = args.getValueForOption("--quality");
+            for (int q = 0; q < SaturatorDSPBase::numQualities; ++q)
+                if (name.equalsIgnoreCase(getQualityName(static_cast<SaturatorDSPBase::Quality>(q))))
+                    settings.quality = static_cast<SaturatorDSPBase::Quality>(q);
+        }
+
+        if (args.containsOption("--filter"))
+        {
+            const auto name = args.getValueForOption("--filter");
+            for (int f = 0; f < SaturatorDSPBase::numFilters; ++f)
+                if (name.equalsIgnoreCase(getFilterName(static_cast<SaturatorDSPBase::Filter>(f))))
+                    settings.filter = static_cast<SaturatorDSPBase::Filter>(f);
+        }
+
+        if (args.getValueForOption("--kernel").equalsIgnoreCase("exact"))
+            settings.kernel = ValveShaper::Kernel::Exact;
+
+        if (args.getValueForOption("--sag-detector").equalsIgnoreCase("rms"))
+            settings.sagDetector = SaturatorDSPBase::SagDetector::RMS;
+
+        settings.sagLinked = args.containsOption("--sag-link");
+
+        if (args.containsOption("--output-dir"))
+        {
+            options.outputDir = args.getFileForOption("--output-dir");
+            options.outputDir.createDirectory();
+        }
+
+        if (args.containsOption("--suffix"))
+            options.suffix = args.getValueForOption("--suffix");
+
+        if (args.containsOption("--bits"))
+        {
+            options.bitDepth = args.getValueForOption("--bits").getIntValue();
+            if (options.bitDepth != 16 && options.bitDepth != 24 && options.bitDepth != 32)
+            {
+                std::cerr << "--bits must be 16, 24 or 32" << std::endl;
+                return false;
+            }
+        }
+
+        if (args.containsOption("--chunk"))
+            options.chunkSize = juce::jlimit(32, 65536, args.getValueForOption("--chunk").getIntValue());
+
+        if (args.containsOption("--jobs"))
+            options.numJobs = juce::jmax(1, args.getValueForOption("--jobs").getIntValue());
+
+        for (auto& arg : args.arguments)
+            if (! arg.isOption())
+                options.inputs.add(arg.resolveAsFile());
+
+        return ! options.inputs.isEmpty();
+    }
+
+    //==========================================================================
+    // Rendering
+    //==========================================================================
+
+    juce::File getOutputFile(const juce::File& input, const Options& options)
+    {
+        const auto dir = options.outputDir == juce::File() ? input.getParentDirectory() : options.outputDir;
+        return dir.getChildFile(input.getFileNameWithoutExtension() + options.suffix + ".wav");
+    }
+
+    // Renders one file; returns an empty string on success, else the reason
+    juce::String renderFile(const juce::File& input, const Options& options)
+    {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+
+        std::unique_ptr<juce::AudioFormatReader> reader(formats.createReaderFor(input));
+        if (reader == nullptr)
+            return "unsupported or unreadable file";
+
+        const int numChannels = static_cast<int>(reader->numChannels);
+        if (numChannels < 1 || numChannels > SaturatorDSPBase::maxChannels)
+            return "unsupported channel count " + juce::String(numChannels);
+
+        const auto& settings = options.settings;
+        const auto length = reader->lengthInSamples;
+        const double sampleRate = reader->sampleRate;
+        const int chunkSize = options.chunkSize;
+
+        int bitDepth = options.bitDepth;
+        if (bitDepth == 0)
+            bitDepth = (reader->bitsPerSample == 16 || reader->bitsPerSample == 32) ? static_cast<int>(reader->bitsPerSample) : 24;
+
+        // Write to a temporary file first so a failed render never leaves a
+        // truncated output behind
+        const auto outputFile = getOutputFile(input, options);
+        juce::TemporaryFile temp(outputFile);
+
+        std::unique_ptr<juce::AudioFormatWriter> writer;
+        {
+            auto stream = temp.getFile().createOutputStream();
+            if (stream == nullptr)
+                return "cannot write " + outputFile.getFullPathName();
+
+            juce::WavAudioFormat wav;
+            writer.reset(wav.createWriterFor(stream.get(), sampleRate, static_cast<unsigned int>(numChannels),
+                                             bitDepth, {}, 0));
+            if (writer == nullptr)
+                return "cannot create a " + juce::String(bitDepth) + "-bit WAV writer";
+
+            stream.release();   // now owned by the writer
+        }
+
+        const SaturatorDSPBase::QualitySetting quality { settings.quality, settings.filter };
+
+        SaturatorDSP<float> dsp;
+        dsp.setShaperKernel(settings.kernel);
+        dsp.setSagDetection(settings.sagDetector, settings.sagLinked);
+        dsp.setQualitiesInUse({ quality }, settings.numBands);
+        dsp.prepare(sampleRate, chunkSize, numChannels);
+
+        // Same rounding as the plugin's reported latency, so renders null
+        // against a latency-compensated host bounce
+        const auto latency = static_cast<juce::int64>(std::ceil(dsp.getLatencyInSamples(quality)));
+        const auto params = settings.toParameters();
+
+        juce::AudioBuffer<float> chunk(numChannels, chunkSize);
+        juce::int64 readPos = 0;
+        juce::int64 written = 0;
+        juce::int64 toSkip = latency;
+
+        // Input runs out first; zeros then flush the last latency samples
+        while (written < length)
+        {
+            const int numSamples = static_cast<int>(juce::jmin(static_cast<juce::int64>(chunkSize),
+                                                               length + latency - readPos));
+            chunk.setSize(numChannels, numSamples, false, false, true);
+            chunk.clear();
+
+            const auto available = juce::jmax(static_cast<juce::int64>(0), juce::jmin(length - readPos,
+                                                                                   static_cast<juce::int64>(numSamples)));
+            if (available > 0
+                && ! reader->read(&chunk, 0, static_cast<int>(available), readPos, true, true))
+                return "read error at sample " + juce::String(readPos);
+
+            readPos += numSamples;
+            dsp.process(chunk, params, settings.mode, quality);
+
+            const auto skip = juce::jmin(toSkip, static_cast<juce::int64>(numSamples));
+            toSkip -= skip;
+
+            const auto count = juce::jmin(static_cast<juce::int64>(numSamples) - skip, length - written);
+            if (count > 0
+                && ! writer->writeFromAudioSampleBuffer(chunk, static_cast<int>(skip), static_cast<int>(count)))
+                return "write error";
+
+            written += count;
+        }
+
+        writer.reset();
+
+        if (! temp.overwriteTargetFileWithTemporary())
+            return "cannot replace " + outputFile.getFullPathName();
+
+        return {};
+    }
+
+    void printUsage()
+    {
+        std::cout << "saturator-render [options] <file>...\n"
+                     "  --state=<file>           plugin state saved by getStateInformation\n"
+                     "  --mode=Triode|Pentode|Torture\n"
+                     "  --quality=Standard|Live2x|Live1x|Fixed2x|Fixed4x|Fixed8x|Fixed16x\n"
+                     "  --filter=iir|fir         oversampling filter (default iir)\n"
+                     "  --input-trim=<dB>  --drive=<dB>  --bias=<-0.6..0.6>  --sag=<0..0.6>\n"
+                     "  --output-trim=<dB> --mix=<percent>\n"
+                     "  --bands=1|2|3            multiband split (default 1, off)\n"
+                     "  --low-crossover=<Hz>  --high-crossover=<Hz>\n"
+                     "  --low-drive=<dB>  --mid-drive=<dB>  --high-drive=<dB>   0 turns a band off\n"
+                     "  --kernel=fast|exact      valve shaper kernel (default fast)\n"
+                     "  --sag-detector=peak|rms  sag envelope detection (default peak)\n"
+                     "  --sag-link               one sag envelope for all channels, from the loudest\n"
+                     "  --output-dir=<dir>       default: next to each input\n"
+                     "  --suffix=_saturated      appended to the output file name\n"
+                     "  --bits=16|24|32          WAV bit depth (default: as input, else 24)\n"
+                     "  --chunk=4096             samples per process() call\n"
+                     "  --jobs=<n>               files rendered at once (default: CPU count)\n";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    juce::ArgumentList args(argc, argv);
+
+    if (args.containsOption("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    Options options;
+    if (! parseOptions(args, options))
+    {
+        printUsage();
+        return 1;
+    }
+
+    const auto& s = options.settings;
+    std::cerr << getModeName(s.mode) << "/" << getQualityName(s.quality) << "/" << getFilterName(s.filter)
+              << " drive " << s.driveDb << " dB, " << s.numBands << " band(s), " << options.inputs.size() << " file(s), "
+              << options.numJobs << " job(s)" << std::endl;
+
+    juce::ThreadPool pool(juce::jmin(options.numJobs, options.inputs.size()));
+    juce::CriticalSection outputLock;
+    juce::WaitableEvent finished;
+    std::atomic<int> remaining { options.inputs.size() };
+    std::atomic<int> failures { 0 };
+
+    for (auto& input : options.inputs)
+    {
+        pool.addJob([&, input]
+        {
+            juce::ScopedNoDenormals noDenormals;
+            const auto error = renderFile(input, options);
+
+            {
+                const juce::ScopedLock sl(outputLock);
+                if (error.isEmpty())
+                {
+                    std::cout << getOutputFile(input, options).getFullPathName() << std::endl;
+                }
+                else
+                {
+                    std::cerr << "FAILED " << input.getFullPathName() << ": " << error << std::endl;
+                    ++failures;
+                }
+            }
+
+            if (--remaining == 0)
+                finished.signal();
+        });
+    }
+
+    finished.wait();
+    return failures > 0 ? 1 : 0;
+}